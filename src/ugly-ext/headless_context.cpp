@@ -0,0 +1,181 @@
+#include "headless_context.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace glx {
+
+
+namespace {
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+bool has_extension(const char* extensions, const char* name) {
+  if (!extensions) {
+    return false;
+  }
+  auto length = std::strlen(name);
+  for (auto p = std::strstr(extensions, name); p; p = std::strstr(p + length, name)) {
+    if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+// EGL hands every HeadlessContext the same display, and eglTerminate would pull
+// it out from under the others: count the contexts on each one, and terminate
+// it with the last.
+std::mutex display_lock;
+std::map<EGLDisplay, unsigned> display_refs;
+
+EGLDisplay retain_display(EGLDisplay display) {
+  std::lock_guard<std::mutex> lock (display_lock);
+  ++display_refs[display];
+  return display;
+}
+
+void release_display(EGLDisplay display) {
+  std::lock_guard<std::mutex> lock (display_lock);
+  auto refs = display_refs.find(display);
+  if (refs != display_refs.end() && --refs->second == 0) {
+    display_refs.erase(refs);
+    eglTerminate(display);
+  }
+}
+
+// Prefer a display that needs no window system at all; fall back to the
+// default display, which works wherever there is one.
+EGLDisplay open_display() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  auto client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+      auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+        return retain_display(display);
+      }
+    }
+  }
+#endif
+
+  auto display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    throw gl::exception("couldn't initialize an EGL display: %d", eglGetError());
+  }
+  return retain_display(display);
+}
+
+}
+
+
+namespace detail {
+
+EglSurface::EglSurface(HeadlessConfig const& config, HeadlessContext const* share) {
+  auto display = open_display();
+  _display = display;
+  try {
+    create(config, share);
+  } catch (...) {
+    release_display(display);
+    throw;
+  }
+}
+
+void EglSurface::create(HeadlessConfig const& config, HeadlessContext const* share) {
+  auto display = static_cast<EGLDisplay>(_display);
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    throw gl::exception("EGL can't create desktop OpenGL contexts: %d", eglGetError());
+  }
+
+  const EGLint config_attributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, EGLint(config.depth_bits),
+    EGL_STENCIL_SIZE, EGLint(config.stencil_bits),
+    EGL_NONE
+  };
+  EGLConfig egl_config;
+  EGLint count = 0;
+  if (!eglChooseConfig(display, config_attributes, &egl_config, 1, &count) || count == 0) {
+    throw gl::exception("no EGL config for a %ux%u pbuffer", config.width, config.height);
+  }
+
+  const EGLint surface_attributes[] = {
+    EGL_WIDTH, EGLint(config.width),
+    EGL_HEIGHT, EGLint(config.height),
+    EGL_NONE
+  };
+  _surface = eglCreatePbufferSurface(display, egl_config, surface_attributes);
+  if (_surface == EGL_NO_SURFACE) {
+    throw gl::exception("couldn't create a %ux%u pbuffer: %d", config.width, config.height, eglGetError());
+  }
+
+  std::vector<EGLint> context_attributes {
+    EGL_CONTEXT_MAJOR_VERSION, EGLint(config.major_version),
+    EGL_CONTEXT_MINOR_VERSION, EGLint(config.minor_version),
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+  };
+  if (config.debug) {
+    context_attributes.insert(context_attributes.end(), { EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE });
+  }
+  context_attributes.push_back(EGL_NONE);
+
+  auto shared = share ? static_cast<EglSurface const*>(share)->_context : EGL_NO_CONTEXT;
+  _context = eglCreateContext(display, egl_config, shared, context_attributes.data());
+  if (_context == EGL_NO_CONTEXT) {
+    eglDestroySurface(display, _surface);
+    throw gl::exception("couldn't create an OpenGL %u.%u context: %d",
+      config.major_version, config.minor_version, eglGetError());
+  }
+}
+
+EglSurface::~EglSurface() {
+  if (eglGetCurrentContext() == _context) {
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+  eglDestroyContext(_display, _context);
+  eglDestroySurface(_display, _surface);
+  release_display(_display);
+}
+
+void EglSurface::make_surface_current(void* handle) {
+  auto surface = static_cast<EglSurface*>(handle);
+  if (!eglMakeCurrent(surface->_display, surface->_surface, surface->_surface, surface->_context)) {
+    throw gl::exception("eglMakeCurrent failed: %d", eglGetError());
+  }
+}
+
+gl::OS_Bridge EglSurface::surface_bridge() {
+  gl::OS_Bridge bridge;
+  bridge.make_current = &EglSurface::make_surface_current;
+  return bridge;
+}
+
+}
+
+
+HeadlessContext::HeadlessContext(HeadlessConfig const& config, HeadlessContext const* share)
+  : detail::EglSurface(config, share)
+  , gl::MultiContext(static_cast<detail::EglSurface*>(this), surface_bridge())
+  , _width(config.width)
+  , _height(config.height)
+{
+  viewport(0, 0, _width, _height);
+}
+
+HeadlessContext::~HeadlessContext() {}
+
+
+}
@@ -0,0 +1,83 @@
+#ifndef UGLY_EXT_HEADLESS_CONTEXT_H
+#define UGLY_EXT_HEADLESS_CONTEXT_H
+
+#include "ugly/ugly.h"
+
+namespace glx {
+
+
+struct HeadlessConfig {
+  unsigned width { 1024 };
+  unsigned height { 1024 };
+  unsigned major_version { 4 };
+  unsigned minor_version { 1 };
+  unsigned depth_bits { 24 };
+  unsigned stencil_bits { 8 };
+  bool debug { false };
+};
+
+
+class HeadlessContext;
+
+namespace detail {
+
+// Owns the pbuffer surface and context, and a reference to the EGL display,
+// which is terminated along with the last EglSurface on it. It's a base of
+// HeadlessContext so that it's constructed before, and destroyed after, the
+// MultiContext that wraps it.
+class EglSurface {
+  protected:
+    EglSurface(HeadlessConfig const&, HeadlessContext const* share);
+    ~EglSurface();
+    EglSurface(EglSurface const&) = delete;
+    EglSurface& operator=(EglSurface const&) = delete;
+
+  private:
+    void create(HeadlessConfig const&, HeadlessContext const* share);
+
+  protected:
+    static void make_surface_current(void* surface);
+    static gl::OS_Bridge surface_bridge();
+
+  protected:
+    void* _display { nullptr };
+    void* _surface { nullptr };
+    void* _context { nullptr };
+};
+
+}
+
+
+/**
+ * @brief a Context with no window: an EGL pbuffer of the configured size is
+ * its default framebuffer. Needs only a working EGL (Mesa's llvmpipe on the
+ * surfaceless platform is enough), so it runs on machines without a display.
+ *
+ * Like any MultiContext it belongs to the thread that created it. Pass
+ * another HeadlessContext as `share` to share objects with it, e.g. to upload
+ * from a second thread.
+ **/
+class HeadlessContext
+  : private detail::EglSurface
+  , public gl::MultiContext
+{
+  public:
+    HeadlessContext(HeadlessConfig const& = HeadlessConfig(), HeadlessContext const* share = nullptr);
+    ~HeadlessContext() override;
+
+  public:
+    unsigned width() const { return _width; }
+    unsigned height() const { return _height; }
+
+  private:
+    friend class detail::EglSurface;
+
+    unsigned _width;
+    unsigned _height;
+
+};
+
+
+}
+
+#endif
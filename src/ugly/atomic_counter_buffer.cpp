@@ -0,0 +1,54 @@
+#include "atomic_counter_buffer.h"
+#include "uniform_buffer.h"
+#include "state_cache.h"
+
+#ifdef GL_VERSION_4_2
+
+using namespace gl;
+
+AtomicCounterBuffer::AtomicCounterBuffer(size_t counters /* = 1 */, GLenum usage /* = GL_DYNAMIC_DRAW */) {
+  _buffer.data(std::vector<GLuint>(counters, 0), usage, GL_ATOMIC_COUNTER_BUFFER);
+}
+
+AtomicCounterBuffer::~AtomicCounterBuffer() {}
+
+
+void AtomicCounterBuffer::set(size_t counter, GLuint value) {
+  GL_ASSERT(counter < counters(), "setting counter %u of %u", counter, counters());
+  _buffer.write(counter * sizeof(GLuint), sizeof(GLuint), &value);
+}
+
+GLuint AtomicCounterBuffer::get(size_t counter) const {
+  GL_ASSERT(counter < counters(), "reading counter %u of %u", counter, counters());
+  GLuint value;
+  _buffer.get(counter * sizeof(GLuint), sizeof(GLuint), &value);
+  return value;
+}
+
+std::vector<GLuint> AtomicCounterBuffer::values() const {
+  std::vector<GLuint> values (counters());
+  _buffer.get(0, values.size() * sizeof(GLuint), values.data());
+  return values;
+}
+
+void AtomicCounterBuffer::reset(GLuint value /* = 0 */) {
+  _buffer.clear(value);
+}
+
+
+void AtomicCounterBuffer::bind(GLuint binding) const {
+  GL_CALL(glBindBufferBase(
+    GL_ATOMIC_COUNTER_BUFFER,
+    binding,
+    _buffer.name()
+  ));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(GL_ATOMIC_COUNTER_BUFFER, _buffer.name());
+  }
+}
+
+void AtomicCounterBuffer::bind(GLuint binding, size_t offset, size_t size) const {
+  detail::bind_buffer_range(GL_ATOMIC_COUNTER_BUFFER, binding, _buffer, offset, size);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef UGLY_ATOMIC_COUNTER_BUFFER_H
+#define UGLY_ATOMIC_COUNTER_BUFFER_H
+
+#include "buffer.h"
+#include <vector>
+
+#ifdef GL_VERSION_4_2
+
+namespace gl {
+
+
+/**
+ * @brief a Buffer of `counters` atomic_uint counters (GL 4.2), starting at 0.
+ * Reading them back waits for the shaders that count; use
+ * Context::memory_barrier(GL_ATOMIC_COUNTER_BARRIER_BIT) between passes that
+ * write and read them on the GPU.
+ **/
+class AtomicCounterBuffer {
+  public:
+    explicit AtomicCounterBuffer(size_t counters = 1, GLenum usage = GL_DYNAMIC_DRAW);
+
+  public:
+    ~AtomicCounterBuffer();
+    AtomicCounterBuffer(AtomicCounterBuffer const&) = delete;
+    AtomicCounterBuffer& operator=(AtomicCounterBuffer const&) = delete;
+    AtomicCounterBuffer(AtomicCounterBuffer&&) = default;
+    AtomicCounterBuffer& operator=(AtomicCounterBuffer&&) = default;
+
+  public:
+    size_t counters() const { return _buffer.size() / sizeof(GLuint); }
+
+    void set(size_t counter, GLuint value);
+    GLuint get(size_t counter) const;
+    std::vector<GLuint> values() const;
+
+    /**
+     * @brief set every counter to `value`, on the GPU.
+     **/
+    void reset(GLuint value = 0);
+
+  public:
+    void bind(GLuint binding) const;
+
+    /**
+     * @brief bind `size` bytes from `offset` to `binding`; the shader's
+     * layout(offset = N) counts from `offset`.
+     **/
+    void bind(GLuint binding, size_t offset, size_t size) const;
+
+    Buffer& buffer() { return _buffer; }
+    Buffer const& buffer() const { return _buffer; }
+
+  private:
+    Buffer _buffer;
+
+};
+
+
+}
+
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include "gl_type.h"
+#include "state_cache.h"
 #include "buffer.h"
 #include "framebuffer.h"
 #include "texture.h"
@@ -10,33 +11,207 @@
 namespace gl {
 
 
+namespace {
+
+// Route each bind function through the matching StateCache member, falling back
+// to the raw call when no Context is current on this thread.
+
+template<void(*BindFunction)(GLenum, GLuint)>
+void bind(StateCache*, GLenum target, GLuint name);
+
+template<void(*BindFunction)(GLenum, GLuint)>
+GLuint bound(StateCache const&, GLenum target);
+
+template<> inline void bind<glBindBuffer>(StateCache* state, GLenum target, GLuint name) {
+  if (state) { state->bind_buffer(target, name); } else { GL_CALL(glBindBuffer(target, name)); }
+}
+
+template<> inline GLuint bound<glBindBuffer>(StateCache const& state, GLenum target) {
+  return state.bound_buffer(target);
+}
+
+template<> inline void bind<glBindTexture>(StateCache* state, GLenum target, GLuint name) {
+  if (state) { state->bind_texture(target, name); } else { GL_CALL(glBindTexture(target, name)); }
+}
+
+template<> inline GLuint bound<glBindTexture>(StateCache const& state, GLenum target) {
+  return state.bound_texture(target);
+}
+
+template<> inline void bind<glBindFramebuffer>(StateCache* state, GLenum target, GLuint name) {
+  if (state) { state->bind_framebuffer(target, name); } else { GL_CALL(glBindFramebuffer(target, name)); }
+}
+
+template<> inline GLuint bound<glBindFramebuffer>(StateCache const& state, GLenum target) {
+  return state.bound_framebuffer(target);
+}
+
+template<> inline void bind<glBindRenderbuffer>(StateCache* state, GLenum target, GLuint name) {
+  if (state) { state->bind_renderbuffer(target, name); } else { GL_CALL(glBindRenderbuffer(target, name)); }
+}
+
+template<> inline GLuint bound<glBindRenderbuffer>(StateCache const& state, GLenum) {
+  return state.bound_renderbuffer();
+}
+
+
+template<void(*BindFunction)(GLuint)>
+void bind(StateCache*, GLuint name);
+
+template<void(*BindFunction)(GLuint)>
+GLuint bound(StateCache const&);
+
+template<> inline void bind<glActiveTexture>(StateCache* state, GLuint unit) {
+  if (state) { state->active_texture(unit); } else { GL_CALL(glActiveTexture(GL_TEXTURE0 + unit)); }
+}
+
+template<> inline GLuint bound<glActiveTexture>(StateCache const& state) {
+  return state.active_texture();
+}
+
+template<> inline void bind<glBindVertexArray>(StateCache* state, GLuint name) {
+  if (state) { state->bind_vertex_array(name); } else { GL_CALL(glBindVertexArray(name)); }
+}
+
+template<> inline GLuint bound<glBindVertexArray>(StateCache const& state) {
+  return state.vertex_array();
+}
+
+template<> inline void bind<glUseProgram>(StateCache* state, GLuint name) {
+  if (state) { state->use_program(name); } else { GL_CALL(glUseProgram(name)); }
+}
+
+template<> inline GLuint bound<glUseProgram>(StateCache const& state) {
+  return state.program();
+}
+
+
+// Textures are edited on unit 0; TextureUnit hands out 1 and up, so with
+// BINDING_LEAVE_BOUND an edit can't clobber a texture left bound for sampling.
+// Returns the unit to go back to, or UNKNOWN.
+template<void(*BindFunction)(GLenum, GLuint)>
+inline GLuint prepare(StateCache&, GLenum) {
+  return StateCache::UNKNOWN;
+}
+
+template<> inline GLuint prepare<glBindTexture>(StateCache& state, GLenum) {
+  GLuint unit = state.active_texture();
+  if (unit == StateCache::UNKNOWN && state.policy() == BINDING_RESTORE_PREVIOUS) {
+    GLint active;
+    GL_CALL(glGetIntegerv(GL_ACTIVE_TEXTURE, &active));
+    unit = GLuint(active - GL_TEXTURE0);
+  }
+  state.active_texture(0);
+  return unit;
+}
+
+// A vertex array left bound by BINDING_LEAVE_BOUND would take the element
+// array buffer as its own.
+template<> inline GLuint prepare<glBindBuffer>(StateCache& state, GLenum target) {
+  if (target == GL_ELEMENT_ARRAY_BUFFER && state.policy() == BINDING_LEAVE_BOUND && !state.vertex_array_held()) {
+    state.bind_vertex_array(0);
+  }
+  return StateCache::UNKNOWN;
+}
+
+
+template<void(*BindFunction)(GLuint)>
+inline void hold(StateCache&) {}
+
+template<void(*BindFunction)(GLuint)>
+inline void release(StateCache&) {}
+
+template<> inline void hold<glBindVertexArray>(StateCache& state) {
+  state.hold_vertex_array();
+}
+
+template<> inline void release<glBindVertexArray>(StateCache& state) {
+  state.release_vertex_array();
+}
+
+
+// What a guard puts back when it goes out of scope, or UNKNOWN to do nothing.
+inline GLuint restore_value(StateCache const* state, GLuint previous, GLuint fallback) {
+  if (!state) {
+    return fallback;
+  }
+  switch (state->policy()) {
+    case BINDING_RESTORE_PREVIOUS:
+      return previous == StateCache::UNKNOWN ? fallback : previous;
+    case BINDING_LEAVE_BOUND:
+      return StateCache::UNKNOWN;
+    default:
+      return fallback;
+  }
+}
+
+}
+
+
 template<typename T, void(*BindFunction)(GLenum, GLuint)>
 Bindguard<T, BindFunction>::Bindguard(GLenum target, T const& object)
-  : _target(target) {
-  GL_CALL(BindFunction(_target, object.name()));
+  : _target(target)
+  , _state(detail::current_state())
+  , _previous(StateCache::UNKNOWN)
+  , _unit(StateCache::UNKNOWN) {
+  if (_state) {
+    _unit = prepare<BindFunction>(*_state, _target);
+    _previous = bound<BindFunction>(*_state, _target);
+  }
+  bind<BindFunction>(_state, _target, object.name());
 }
 
 template<typename T, void(*BindFunction)(GLenum, GLuint)>
 Bindguard<T, BindFunction>::~Bindguard() {
-  GL_CALL(BindFunction(_target, 0));
+  auto name = restore_value(_state, _previous, 0);
+  if (name != StateCache::UNKNOWN) {
+    bind<BindFunction>(_state, _target, name);
+  }
+  if (_unit != StateCache::UNKNOWN) {
+    auto unit = restore_value(_state, _unit, 0);
+    if (unit != StateCache::UNKNOWN) {
+      bind<glActiveTexture>(_state, unit);
+    }
+  }
 }
 
 
 template<typename T, void(*BindFunction)(GLuint), GLuint Default>
-NoTargetBindguard<T, BindFunction, Default>::NoTargetBindguard(T const& object) {
-  GL_CALL(BindFunction(object.name()));
+NoTargetBindguard<T, BindFunction, Default>::NoTargetBindguard(T const& object)
+  : _state(detail::current_state())
+  , _previous(_state ? bound<BindFunction>(*_state) : StateCache::UNKNOWN) {
+  if (_state) {
+    hold<BindFunction>(*_state);
+  }
+  bind<BindFunction>(_state, object.name());
 }
 
 template<typename T, void(*BindFunction)(GLuint), GLuint Default>
 NoTargetBindguard<T, BindFunction, Default>::~NoTargetBindguard() {
-  GL_CALL(BindFunction(Default));
+  auto name = restore_value(_state, _previous, Default);
+  if (name != StateCache::UNKNOWN) {
+    bind<BindFunction>(_state, name);
+  }
+  if (_state) {
+    release<BindFunction>(*_state);
+  }
 }
 
 
 template<>
 NoTargetBindguard<TextureUnit, glActiveTexture, GL_TEXTURE0>::NoTargetBindguard(
-  TextureUnit const& object) {
-  GL_CALL(glActiveTexture(GL_TEXTURE0 + object.unit()));
+  TextureUnit const& object)
+  : _state(detail::current_state())
+  , _previous(_state ? bound<glActiveTexture>(*_state) : StateCache::UNKNOWN) {
+  bind<glActiveTexture>(_state, object.unit());
+}
+
+template<>
+NoTargetBindguard<TextureUnit, glActiveTexture, GL_TEXTURE0>::~NoTargetBindguard() {
+  auto unit = restore_value(_state, _previous, 0);
+  if (unit != StateCache::UNKNOWN) {
+    bind<glActiveTexture>(_state, unit);
+  }
 }
 
 
@@ -0,0 +1,222 @@
+#ifndef UGLY_BLOCK_LAYOUT_H
+#define UGLY_BLOCK_LAYOUT_H
+
+#include "gl_type.h"
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+namespace gl {
+
+
+enum BlockLayoutRule {
+  LAYOUT_STD140,  // uniform blocks
+  LAYOUT_STD430,  // shader storage blocks: arrays and matrices aren't padded to vec4
+};
+
+
+/**
+ * @brief GLSL types, to describe the members of a block. Values are written
+ * from any trivially copyable type of the same size and packing, e.g.
+ * glm::vec3 for glsl::vec<float, 3>, glm::mat3 for glsl::mat<float, 3, 3>.
+ * Scalars are described by their C++ type: float, GLint, GLuint, double; a
+ * GLSL bool is a GLuint.
+ **/
+namespace glsl {
+
+template<typename T, unsigned N>
+struct vec {
+  T data[N];
+};
+
+// Column-major, like GLSL and glm: matC or matCxR.
+template<typename T, unsigned C, unsigned R = C>
+struct mat {
+  T data[C][R];
+};
+
+template<typename T, size_t N>
+struct array {};
+
+// A scalar, vector or matrix: `columns` vectors of `rows` scalars.
+template<typename T>
+struct type {
+  static_assert(std::is_arithmetic<T>::value && sizeof(T) >= 4, "not a GLSL scalar: use float, GLint, GLuint or double");
+  using scalar = T;
+  static constexpr unsigned rows = 1;
+  static constexpr unsigned columns = 1;
+};
+
+template<typename T, unsigned N>
+struct type<vec<T, N>> : type<T> {
+  static_assert(N >= 2 && N <= 4, "GLSL vectors have 2 to 4 components");
+  static constexpr unsigned rows = N;
+};
+
+template<typename T, unsigned C, unsigned R>
+struct type<mat<T, C, R>> : type<T> {
+  static_assert(C >= 2 && C <= 4 && R >= 2 && R <= 4, "GLSL matrices have 2 to 4 columns and rows");
+  static constexpr unsigned rows = R;
+  static constexpr unsigned columns = C;
+};
+
+template<typename T> constexpr unsigned type<T>::rows;
+template<typename T> constexpr unsigned type<T>::columns;
+template<typename T, unsigned N> constexpr unsigned type<vec<T, N>>::rows;
+template<typename T, unsigned C, unsigned R> constexpr unsigned type<mat<T, C, R>>::rows;
+template<typename T, unsigned C, unsigned R> constexpr unsigned type<mat<T, C, R>>::columns;
+
+}
+
+
+namespace detail {
+
+constexpr size_t align_up(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+
+/**
+ * @brief where a member of type T goes under Rule. Matrices are laid out as
+ * arrays of column vectors, and arrays of anything have a fixed `stride`.
+ **/
+template<BlockLayoutRule Rule, typename T>
+struct FieldLayout {
+  using type = glsl::type<T>;
+  using element = T;
+
+  static constexpr bool is_array = false;
+  static constexpr size_t count = 1;
+  static constexpr size_t scalar_size = sizeof(typename type::scalar);
+  static constexpr size_t column_size = type::rows * scalar_size;
+  static constexpr size_t packed_size = type::columns * column_size;  // of the C++ value
+
+  // A vector aligns to 2 or 4 of its scalars; a column of a matrix too, but
+  // std140 rounds that up to a vec4.
+  static constexpr size_t vector_alignment = (type::rows == 1 ? 1 : type::rows == 2 ? 2 : 4) * scalar_size;
+  static constexpr size_t column_stride = Rule == LAYOUT_STD140 ? detail::align_up(vector_alignment, 16) : vector_alignment;
+
+  static constexpr size_t alignment = type::columns == 1 ? vector_alignment : column_stride;
+  static constexpr size_t size = type::columns == 1 ? column_size : type::columns * column_stride;
+  static constexpr size_t stride = size;
+};
+
+template<BlockLayoutRule Rule, typename T> constexpr bool FieldLayout<Rule, T>::is_array;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::count;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::scalar_size;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::column_size;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::packed_size;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::vector_alignment;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::column_stride;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::alignment;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::size;
+template<BlockLayoutRule Rule, typename T> constexpr size_t FieldLayout<Rule, T>::stride;
+
+
+template<BlockLayoutRule Rule, typename T, size_t N>
+struct FieldLayout<Rule, glsl::array<T, N>> : FieldLayout<Rule, T> {
+  static_assert(N > 0, "arrays need a size");
+  using base = FieldLayout<Rule, T>;
+
+  static constexpr bool is_array = true;
+  static constexpr size_t count = N;
+  static constexpr size_t alignment = Rule == LAYOUT_STD140 ? detail::align_up(base::alignment, 16) : base::alignment;
+  static constexpr size_t stride = detail::align_up(base::size, alignment);
+  static constexpr size_t size = N * stride;
+};
+
+template<BlockLayoutRule Rule, typename T, size_t N> constexpr bool FieldLayout<Rule, glsl::array<T, N>>::is_array;
+template<BlockLayoutRule Rule, typename T, size_t N> constexpr size_t FieldLayout<Rule, glsl::array<T, N>>::count;
+template<BlockLayoutRule Rule, typename T, size_t N> constexpr size_t FieldLayout<Rule, glsl::array<T, N>>::alignment;
+template<BlockLayoutRule Rule, typename T, size_t N> constexpr size_t FieldLayout<Rule, glsl::array<T, N>>::stride;
+template<BlockLayoutRule Rule, typename T, size_t N> constexpr size_t FieldLayout<Rule, glsl::array<T, N>>::size;
+
+
+/**
+ * @brief the std140 or std430 layout of a block whose members have the
+ * types `Fields`, in order:
+ *
+ *   using Material = gl::BlockLayout<gl::LAYOUT_STD140,
+ *     gl::glsl::vec<float, 4>,                   // vec4 color;
+ *     float,                                     // float roughness;
+ *     gl::glsl::array<gl::glsl::vec<float, 3>, 4> // vec3 lights[4];
+ *   >;
+ *   static_assert(Material::offset<2>() == 32, "");
+ *
+ * Everything is computed at compile time. Nested structs aren't supported.
+ **/
+template<BlockLayoutRule Rule, typename... Fields>
+struct BlockLayout {
+  static_assert(sizeof...(Fields) > 0, "a block needs members");
+
+  static constexpr BlockLayoutRule rule = Rule;
+  static constexpr size_t count = sizeof...(Fields);
+
+  template<size_t I>
+  using field = FieldLayout<Rule, typename std::tuple_element<I, std::tuple<Fields...>>::type>;
+
+  static constexpr size_t offset(size_t index) {
+    const size_t alignments[] = { FieldLayout<Rule, Fields>::alignment... };
+    const size_t sizes[] = { FieldLayout<Rule, Fields>::size... };
+    size_t end = 0;
+    for (size_t i = 0; i < index; ++i) {
+      end = detail::align_up(end, alignments[i]) + sizes[i];
+    }
+    return index < count ? detail::align_up(end, alignments[index]) : end;
+  }
+
+  template<size_t I>
+  static constexpr size_t offset() {
+    static_assert(I < count, "no such member");
+    return offset(I);
+  }
+
+  static constexpr size_t alignment() {
+    const size_t alignments[] = { FieldLayout<Rule, Fields>::alignment... };
+    size_t largest = Rule == LAYOUT_STD140 ? 16 : 1;
+    for (size_t a : alignments) {
+      largest = a > largest ? a : largest;
+    }
+    return largest;
+  }
+
+  /**
+   * @brief bytes in the whole block, padded to its alignment.
+   **/
+  static constexpr size_t size() {
+    return detail::align_up(offset(count), alignment());
+  }
+
+  /**
+   * @brief write `n` elements of member I, from `index` on, into a block at
+   * `block`. A member that isn't an array has the one element 0.
+   **/
+  template<size_t I, typename U>
+  static void write(void* block, U const* values, size_t n = 1, size_t index = 0) {
+    using F = field<I>;
+    static_assert(std::is_trivially_copyable<U>::value, "values are copied bytewise");
+    static_assert(sizeof(U) == F::packed_size, "value doesn't match the member's GLSL type");
+    static_assert(F::type::rows > 1 || std::is_same<U, typename F::type::scalar>::value, "scalar value doesn't match the member's type");
+
+    auto dest = static_cast<char*>(block) + offset<I>() + index * F::stride;
+    auto src = reinterpret_cast<char const*>(values);
+    for (size_t i = 0; i < n; ++i) {
+      for (unsigned c = 0; c < F::type::columns; ++c) {
+        std::memcpy(dest + c * F::column_stride, src + c * F::column_size, F::column_size);
+      }
+      dest += F::stride;
+      src += sizeof(U);
+    }
+  }
+};
+
+template<BlockLayoutRule Rule, typename... Fields> constexpr BlockLayoutRule BlockLayout<Rule, Fields...>::rule;
+template<BlockLayoutRule Rule, typename... Fields> constexpr size_t BlockLayout<Rule, Fields...>::count;
+
+
+} // namespace gl
+
+#endif
@@ -1,13 +1,21 @@
 #include "buffer.h"
 #include "texture.h"
+#include "capabilities.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace gl {
 
 
 void Buffer::data(size_t size, void const* data, GLenum usage, GLenum target) {
+  if (_immutable) {
+    throw gl::exception("can't respecify buffer %u: its storage is immutable", name());
+  }
   // 4.5: see glNamedBufferData
   BufferBindguard guard(target, *this);
   GL_CALL(glBufferData(target, size, data, usage));
+  _size = size;
 }
 
 
@@ -17,33 +25,236 @@ void Buffer::_subdata(size_t offset, size_t size, void const* data, GLenum targe
 }
 
 
-void* Buffer::map(GLenum target, GLenum access) {
-  GL_ASSERT(!_mapped, "mapping already-mapped buffer %p", this);
+// Mapping state belongs to the buffer object, so everything is done on
+// GL_COPY_WRITE_BUFFER, whatever the buffer is used for.
+void* Buffer::map(size_t offset, size_t length, GLbitfield access, GLenum legacy_access) {
+  if (_map) {
+    throw gl::exception("buffer %u is already mapped", name());
+  }
+  if (offset + length > _size) {
+    throw gl::exception("can't map [%u, %u) of buffer %u, which has %u bytes", offset, offset + length, name(), _size);
+  }
+
   void* p;
-  BufferBindguard guard(target, *this);
-  GL_CALL(p = glMapBuffer(target, access));
+  BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+  if (legacy_access) {
+    GL_CALL(p = glMapBuffer(GL_COPY_WRITE_BUFFER, legacy_access));
+  } else {
+    GL_CALL(p = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, access));
+  }
   if (p) {
-    _target = target;
-    _mapped = true;
+    _map = p;
+    _map_length = length;
+    _map_access = access;
   }
   return p;
 }
 
+void* Buffer::map(GLenum /* target */, GLenum access) {
+  return map(0, _size, 0, access);
+}
+
+void* Buffer::map_range(size_t offset, size_t length, GLbitfield access) {
+  return map(offset, length, access, 0);
+}
+
+void Buffer::flush_mapped_range(size_t offset, size_t length) {
+  GL_ASSERT(_map, "flushing buffer %p, which is not mapped", this);
+  GL_ASSERT(_map_access & GL_MAP_FLUSH_EXPLICIT_BIT, "flushing buffer %p, which wasn't mapped with GL_MAP_FLUSH_EXPLICIT_BIT", this);
+  GL_ASSERT(offset + length <= _map_length, "flushing [%u, %u) past the end of a %u byte mapping", offset, offset + length, _map_length);
+  BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+  GL_CALL(glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, offset, length));
+}
+
 bool Buffer::unmap() {
-  GL_ASSERT(_mapped, "unmapping buffer %p, which is not mapped", this);
+  GL_ASSERT(_map, "unmapping buffer %p, which is not mapped", this);
+  // The buffer is unmapped even when glUnmapBuffer returns false.
+  _map = nullptr;
+  _map_access = 0;
   bool rv;
-  BufferBindguard guard(_target, *this);
-  GL_CALL(rv = glUnmapBuffer(_target));
-  if (rv) {
-    _mapped = false;
-  }
+  BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+  GL_CALL(rv = glUnmapBuffer(GL_COPY_WRITE_BUFFER));
   return rv;
 }
 
 
+void Buffer::storage(size_t size, GLbitfield flags, void const* data /* = nullptr */) {
+#ifdef GL_VERSION_4_4
+  if (_immutable) {
+    throw gl::exception("buffer %u already has immutable storage", name());
+  }
+  BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+  GL_CALL(glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags));
+  _size = size;
+  _storage_flags = flags;
+  _immutable = true;
+#else
+  throw gl::exception("glBufferStorage needs OpenGL 4.4");
+#endif
+}
+
+void* Buffer::persistent_map() {
+#ifdef GL_VERSION_4_4
+  if (_map && (_map_access & GL_MAP_PERSISTENT_BIT)) {
+    return _map;
+  }
+  if (!(_storage_flags & GL_MAP_PERSISTENT_BIT)) {
+    throw gl::exception("buffer %u has no persistent storage to map", name());
+  }
+
+  GLbitfield access = _storage_flags
+    & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+  if ((access & GL_MAP_WRITE_BIT) && !(access & GL_MAP_COHERENT_BIT)) {
+    access |= GL_MAP_FLUSH_EXPLICIT_BIT;
+  }
+
+  auto p = map_range(0, _size, access);
+  if (!p) {
+    throw gl::exception("failed to map buffer %u", name());
+  }
+  return p;
+#else
+  throw gl::exception("persistent mapping needs OpenGL 4.4");
+#endif
+}
+
+void Buffer::flush_range(size_t offset, size_t size) {
+#ifdef GL_VERSION_4_4
+  GL_ASSERT(_map && (_map_access & GL_MAP_PERSISTENT_BIT), "flushing buffer %p, which isn't persistently mapped", this);
+  if (_map_access & GL_MAP_FLUSH_EXPLICIT_BIT) {
+    flush_mapped_range(offset, size);
+  }
+#else
+  throw gl::exception("persistent mapping needs OpenGL 4.4");
+#endif
+}
+
+
 void Buffer::get(size_t offset, size_t size, void* data) const {
   BufferBindguard guard(GL_COPY_READ_BUFFER, *this);
-  glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, data);
+  GL_CALL(glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, data));
+}
+
+
+void Buffer::copy_to(Buffer& destination, size_t src_offset, size_t dst_offset, size_t size) const {
+  copy_to(destination, std::vector<BufferCopy> { BufferCopy { src_offset, dst_offset, size } });
+}
+
+void Buffer::copy_to(Buffer& destination, std::vector<BufferCopy> const& regions) const {
+  for (auto const& r : regions) {
+    if (r.src_offset + r.size > _size || r.dst_offset + r.size > destination._size) {
+      throw gl::exception("copy of %u bytes from %u to %u is out of bounds", r.size, r.src_offset, r.dst_offset);
+    }
+    if (&destination == this && r.src_offset < r.dst_offset + r.size && r.dst_offset < r.src_offset + r.size) {
+      throw gl::exception("copy of %u bytes from %u to %u overlaps itself", r.size, r.src_offset, r.dst_offset);
+    }
+  }
+
+  BufferBindguard read(GL_COPY_READ_BUFFER, *this);
+  BufferBindguard write(GL_COPY_WRITE_BUFFER, destination);
+  for (auto const& r : regions) {
+    GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, r.src_offset, r.dst_offset, r.size));
+  }
+}
+
+void Buffer::clear(size_t offset, size_t size, uint32_t pattern /* = 0 */) {
+  if (offset % 4 || size % 4) {
+    throw gl::exception("clearing buffer %u: offset %u and size %u must be multiples of 4", name(), offset, size);
+  }
+  if (offset + size > _size) {
+    throw gl::exception("can't clear [%u, %u) of buffer %u, which has %u bytes", offset, offset + size, name(), _size);
+  }
+  if (!size) {
+    return;
+  }
+
+#ifdef GL_VERSION_4_3
+  auto caps = detail::current_capabilities();
+  if (caps && caps->version_at_least(4, 3)) {
+    BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+    GL_CALL(glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, &pattern));
+    return;
+  }
+#endif
+
+  // Upload one chunk, then double it with copies inside the buffer.
+  size_t const chunk = std::min(size, size_t(64 * 1024));
+  std::vector<uint32_t> values (chunk / 4, pattern);
+  write(offset, chunk, values.data());
+
+  BufferBindguard read(GL_COPY_READ_BUFFER, *this);
+  BufferBindguard guard(GL_COPY_WRITE_BUFFER, *this);
+  for (size_t filled = chunk; filled < size; filled *= 2) {
+    size_t n = std::min(filled, size - filled);
+    GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, offset + filled, n));
+  }
+}
+
+
+Readback Buffer::read_async(size_t offset, size_t size, void* destination /* = nullptr */) const {
+  return read_async(offset, size, Readback(), destination);
+}
+
+Readback Buffer::read_async(size_t offset, size_t size, Readback&& recycled, void* destination /* = nullptr */) const {
+  if (offset + size > _size) {
+    throw gl::exception("can't read [%u, %u) of buffer %u, which has %u bytes", offset, offset + size, name(), _size);
+  }
+
+  Readback readback (std::move(recycled));
+  if (!readback._staging || readback._staging->size() < size) {
+    readback._staging.reset(new Buffer());
+    readback._staging->data(GLsizei(size), GL_STREAM_READ);
+  }
+  readback._size = size;
+  readback._destination = destination;
+  readback._copied = false;
+
+  {
+    BufferBindguard read(GL_COPY_READ_BUFFER, *this);
+    BufferBindguard write(GL_COPY_WRITE_BUFFER, *readback._staging);
+    GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size));
+  }
+  readback._fence.reset();
+  // Without a flush, polling ready() might never see the fence signal.
+  GL_CALL(glFlush());
+  return readback;
+}
+
+
+Readback::Readback() {}
+
+Readback::~Readback() {}
+
+Readback::Readback(Readback&&) = default;
+
+Readback& Readback::operator=(Readback&&) = default;
+
+bool Readback::ready() const {
+  return _staging && _fence.signaled();
+}
+
+bool Readback::wait(GLuint64 timeout /* = Sync::FOREVER */) const {
+  return _staging && _fence.wait(timeout);
+}
+
+void const* Readback::data() {
+  GL_ASSERT(_staging, "reading an empty Readback");
+  void* host = _destination;
+  if (!host) {
+    _host.resize(std::max(_host.size(), _size));
+    host = _host.data();
+  }
+  if (!_copied) {
+    _fence.wait();
+    auto mapped = _staging->map_range(0, _size, GL_MAP_READ_BIT);
+    if (!mapped) {
+      throw gl::exception("failed to map the staging buffer of a Readback");
+    }
+    std::memcpy(host, mapped, _size);
+    _staging->unmap();
+    _copied = true;
+  }
+  return host;
 }
 
 
@@ -58,6 +269,41 @@ Buffer::Buffer() {}
 
 Buffer::~Buffer() {}
 
+Buffer::Buffer(Buffer&& other) noexcept
+  : GeneratedObject(std::move(other))
+  , _size(other._size)
+  , _storage_flags(other._storage_flags)
+  , _immutable(other._immutable)
+  , _map(other._map)
+  , _map_length(other._map_length)
+  , _map_access(other._map_access)
+{
+  other.forget_storage();
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+  if (this != &other) {
+    GeneratedObject::operator=(std::move(other));
+    _size = other._size;
+    _storage_flags = other._storage_flags;
+    _immutable = other._immutable;
+    _map = other._map;
+    _map_length = other._map_length;
+    _map_access = other._map_access;
+    other.forget_storage();
+  }
+  return *this;
+}
+
+void Buffer::forget_storage() {
+  _size = 0;
+  _storage_flags = 0;
+  _immutable = false;
+  _map = nullptr;
+  _map_length = 0;
+  _map_access = 0;
+}
+
 
 
 } // namespace gl
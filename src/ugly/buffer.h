@@ -3,17 +3,30 @@
 
 #include "gl_type.h"
 #include "generated_object.h"
+#include "sync.h"
 
 #include <vector>
 #include <array>
+#include <memory>
 #include <type_traits>
 
 namespace gl {
 
 
+class Readback;
 class Texture;
 
 
+/**
+ * @brief one region of a batched Buffer::copy_to(), in bytes.
+ **/
+struct BufferCopy {
+  size_t src_offset;
+  size_t dst_offset;
+  size_t size;
+};
+
+
 class Buffer : public GeneratedObject<glGenBuffers, glDeleteBuffers> {
   public:
     Buffer();
@@ -33,6 +46,8 @@ class Buffer : public GeneratedObject<glGenBuffers, glDeleteBuffers> {
     ~Buffer();
     Buffer(Buffer const&) = delete;
     Buffer& operator=(Buffer const&) = delete;
+    Buffer(Buffer&&) noexcept;
+    Buffer& operator=(Buffer&&) noexcept;
 
   public:
     template<typename T>
@@ -56,6 +71,13 @@ class Buffer : public GeneratedObject<glGenBuffers, glDeleteBuffers> {
 
 
   public:
+    /**
+     * @brief write `size` bytes of `data` at byte `offset`.
+     **/
+    void write(size_t offset, size_t size, void const* data) {
+      _subdata(offset, size, data, GL_COPY_WRITE_BUFFER);
+    }
+
     template<class Container>
     void subdata(size_t offset, size_t count, Container const& container, GLenum target = GL_COPY_WRITE_BUFFER) {
       assert(count <= container.size());
@@ -69,12 +91,145 @@ class Buffer : public GeneratedObject<glGenBuffers, glDeleteBuffers> {
     }
 
   public:
+    /**
+     * @brief map the whole buffer with a legacy access enum (GL_READ_ONLY,
+     * GL_WRITE_ONLY, GL_READ_WRITE). Mapping belongs to the buffer, not to a
+     * target, so `target` is ignored: the buffer is always mapped through
+     * GL_COPY_WRITE_BUFFER. It's kept for source compatibility.
+     **/
     void* map(GLenum target, GLenum access);
+
+    /**
+     * @brief map `length` bytes from `offset` with glMapBufferRange. `access`
+     * combines GL_MAP_READ_BIT / GL_MAP_WRITE_BIT with any of
+     *  - GL_MAP_INVALIDATE_RANGE_BIT: the range's old contents may be
+     *    discarded, so nothing is copied back for it.
+     *  - GL_MAP_INVALIDATE_BUFFER_BIT: likewise for the whole buffer.
+     *  - GL_MAP_UNSYNCHRONIZED_BIT: don't wait for draws still using the
+     *    buffer; use a Sync to make sure that's safe.
+     *  - GL_MAP_FLUSH_EXPLICIT_BIT: only ranges passed to
+     *    flush_mapped_range() are written back.
+     **/
+    void* map_range(size_t offset, size_t length, GLbitfield access);
+
+    /**
+     * @brief map_range() counting in elements of T.
+     **/
+    template<typename T>
+    span<T> map_range(size_t first, size_t count, GLbitfield access) {
+      return span<T>(static_cast<T*>(map_range(first * sizeof(T), count * sizeof(T), access)), count);
+    }
+
+    /**
+     * @brief write back [offset, offset + length) of a mapping made with
+     * GL_MAP_FLUSH_EXPLICIT_BIT. The offset is from the start of the mapping.
+     **/
+    void flush_mapped_range(size_t offset, size_t length);
+
+    /**
+     * @brief end the current mapping, which invalidates its pointer. Returns
+     * false if the contents were corrupted while mapped (e.g. by a mode
+     * switch) and have to be uploaded again.
+     **/
     bool unmap();
+
+    bool mapped() const { return _map != nullptr; }
+
+  public: // immutable storage, GL 4.4 or ARB_buffer_storage
+    /**
+     * @brief allocate immutable storage with glBufferStorage. `flags` are
+     * GL_MAP_READ_BIT, GL_MAP_WRITE_BIT, GL_MAP_PERSISTENT_BIT,
+     * GL_MAP_COHERENT_BIT, GL_DYNAMIC_STORAGE_BIT and GL_CLIENT_STORAGE_BIT.
+     * The size can't change afterwards, and data() may no longer be called.
+     **/
+    void storage(size_t size, GLbitfield flags, void const* data = nullptr);
+
+    template<typename T>
+    void storage(std::vector<T> const& container, GLbitfield flags) {
+      storage(container.size() * sizeof(T), flags, container.data());
+    }
+
+    /**
+     * @brief map the whole of storage created with GL_MAP_PERSISTENT_BIT. The
+     * mapping stays valid, and may be used while drawing, until the Buffer is
+     * destroyed or unmap() is called; mapping again returns the same memory.
+     *
+     * Without GL_MAP_COHERENT_BIT, writes only reach the GPU once passed to
+     * flush_range(). Either way, use a Sync to know when the GPU is done with
+     * a range before rewriting it.
+     **/
+    template<typename T>
+    span<T> persistent_map() {
+      return span<T>(static_cast<T*>(persistent_map()), _size / sizeof(T));
+    }
+
+    void* persistent_map();
+
+    /**
+     * @brief make CPU writes to [offset, offset + size) bytes of a persistent,
+     * non-coherent mapping visible to the GPU. Does nothing for coherent
+     * mappings.
+     **/
+    void flush_range(size_t offset, size_t size);
+
+    template<typename T>
+    void flush_range(span<T> const& written) {
+      flush_range(
+        reinterpret_cast<char const*>(written.data()) - static_cast<char const*>(_map),
+        written.size_bytes());
+    }
+
+    /**
+     * @brief the size of the storage in bytes, as last set by data() or storage().
+     **/
+    size_t size() const { return _size; }
   
 
+  public: // GPU-side copies and fills; no data passes through the CPU
+    /**
+     * @brief copy `size` bytes at `src_offset` to `dst_offset` in
+     * `destination` with glCopyBufferSubData. `destination` may be this
+     * Buffer, if the ranges don't overlap.
+     **/
+    void copy_to(Buffer& destination, size_t src_offset, size_t dst_offset, size_t size) const;
+
+    /**
+     * @brief copy several regions, binding both buffers once.
+     **/
+    void copy_to(Buffer& destination, std::vector<BufferCopy> const& regions) const;
+
+    /**
+     * @brief fill [offset, offset + size) with a repeated 32-bit `pattern`;
+     * offset and size must be multiples of 4. Uses glClearBufferSubData on
+     * GL 4.3; before that, the pattern is uploaded once and doubled with
+     * copies within the buffer.
+     **/
+    void clear(size_t offset, size_t size, uint32_t pattern = 0);
+
+    void clear(uint32_t pattern = 0) {
+      clear(0, _size, pattern);
+    }
+
   public:
+    /**
+     * @brief read back synchronously; waits for every command writing to
+     * the buffer to complete.
+     **/
     void get(size_t offset, size_t size, void* data) const;
+
+    /**
+     * @brief start reading back [offset, offset + size) without waiting:
+     * the range is copied on the GPU into a staging buffer and fenced. The
+     * data arrives in `destination`, which must stay valid until the
+     * Readback is read, or in memory the Readback owns if it's null.
+     **/
+    Readback read_async(size_t offset, size_t size, void* destination = nullptr) const;
+
+    /**
+     * @brief like read_async(offset, size, destination), reusing the staging
+     * buffer and host memory of a Readback that's no longer needed.
+     **/
+    Readback read_async(size_t offset, size_t size, Readback&& recycled, void* destination = nullptr) const;
   
   
   public:
@@ -88,8 +243,79 @@ class Buffer : public GeneratedObject<glGenBuffers, glDeleteBuffers> {
 
 
   private:
-    GLenum _target;
-    bool _mapped { false };
+    void* map(size_t offset, size_t length, GLbitfield access, GLenum legacy_access);
+    void forget_storage();
+
+  private:
+    size_t _size { 0 };
+    GLbitfield _storage_flags { 0 };
+    bool _immutable { false };
+
+    void* _map { nullptr };
+    size_t _map_length { 0 };
+    GLbitfield _map_access { 0 };
+
+};
+
+
+/**
+ * @brief a range of bytes in a Buffer, e.g. one mesh's vertices handed out
+ * by a BufferHeap. Doesn't own anything.
+ **/
+struct BufferSlice {
+  Buffer const* buffer { nullptr };
+  size_t offset { 0 };
+  size_t size { 0 };
+
+  bool empty() const { return buffer == nullptr; }
+};
+
+
+/**
+ * @brief the pending result of Buffer::read_async(). Poll ready() once a
+ * frame, or wait(); data() waits if needed, then copies the result to host
+ * memory the first time it's called.
+ **/
+class Readback {
+  public:
+    Readback();
+    ~Readback();
+    Readback(Readback&&);
+    Readback& operator=(Readback&&);
+    Readback(Readback const&) = delete;
+    Readback& operator=(Readback const&) = delete;
+
+  public:
+    /**
+     * @brief whether the copy has completed on the GPU, without blocking.
+     **/
+    bool ready() const;
+
+    /**
+     * @brief block until the copy has completed or `timeout` nanoseconds
+     * pass. Returns whether it completed.
+     **/
+    bool wait(GLuint64 timeout = Sync::FOREVER) const;
+
+    void const* data();
+
+    template<typename T>
+    span<T const> get() {
+      return span<T const>(static_cast<T const*>(data()), _size / sizeof(T));
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return !_staging; }
+
+  private:
+    friend class Buffer;
+
+    std::unique_ptr<Buffer> _staging;
+    Sync _fence { nullptr };
+    size_t _size { 0 };
+    void* _destination { nullptr };
+    std::vector<char> _host;
+    bool _copied { false };
 
 };
 
@@ -0,0 +1,161 @@
+#include "buffer_heap.h"
+
+#include <algorithm>
+
+namespace gl {
+
+
+namespace {
+
+inline bool is_power_of_two(size_t n) {
+  return n && !(n & (n - 1));
+}
+
+inline size_t align_up(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+
+BufferHeap::BufferHeap(size_t buffer_size /* = 16 << 20 */, size_t min_block /* = 256 */, GLenum usage /* = GL_STATIC_DRAW */)
+  : _buffer_size(buffer_size)
+  , _min_block(min_block)
+  , _max_order(0)
+  , _usage(usage)
+{
+  if (!is_power_of_two(buffer_size) || !is_power_of_two(min_block) || min_block > buffer_size) {
+    throw gl::exception("BufferHeap sizes must be powers of two, got %u and %u", buffer_size, min_block);
+  }
+  while (block_size(_max_order) < buffer_size) {
+    ++_max_order;
+  }
+}
+
+BufferHeap::~BufferHeap() {}
+
+
+BufferSlice BufferHeap::allocate(size_t size, size_t alignment /* = 1 */) {
+  GL_ASSERT(size && alignment, "allocating %u bytes aligned to %u from a BufferHeap", size, alignment);
+
+  // Blocks are aligned to their size, so power-of-two alignments only need a
+  // big enough block; anything else may need padding inside it.
+  size_t needed = is_power_of_two(alignment) ? std::max(size, alignment) : size + alignment - 1;
+  unsigned order = 0;
+  while (order <= _max_order && block_size(order) < needed) {
+    ++order;
+  }
+  if (order > _max_order) {
+    throw gl::exception("can't allocate %u bytes from a BufferHeap of %u byte buffers", size, _buffer_size);
+  }
+
+  Arena* arena = nullptr;
+  unsigned found = 0;
+  for (auto& a : _arenas) {
+    for (unsigned o = order; o <= _max_order; ++o) {
+      if (!a.free[o].empty()) {
+        arena = &a;
+        found = o;
+        break;
+      }
+    }
+    if (arena) {
+      break;
+    }
+  }
+
+  if (!arena) {
+    Arena a;
+    a.buffer.reset(new Buffer());
+    a.buffer->data(GLsizei(_buffer_size), _usage);
+    a.free.resize(_max_order + 1);
+    a.free[_max_order].insert(0);
+    _arenas.push_back(std::move(a));
+    arena = &_arenas.back();
+    found = _max_order;
+  }
+
+  auto& free_list = arena->free[found];
+  size_t offset = *free_list.begin();
+  free_list.erase(free_list.begin());
+  while (found > order) {
+    --found;
+    arena->free[found].insert(offset + block_size(found));
+  }
+  arena->allocated[offset] = order;
+
+  _allocated += block_size(order);
+  _requested += size;
+  return BufferSlice { arena->buffer.get(), align_up(offset, alignment), size };
+}
+
+void BufferHeap::write(BufferSlice const& slice, void const* data) {
+  arena(slice).buffer->write(slice.offset, slice.size, data);
+}
+
+void BufferHeap::free(BufferSlice const& slice) {
+  auto& a = arena(slice);
+
+  // The slice starts in its block, perhaps padded for alignment.
+  auto it = a.allocated.upper_bound(slice.offset);
+  GL_ASSERT(it != a.allocated.begin(), "freeing a slice at %u that isn't allocated", slice.offset);
+  --it;
+  size_t offset = it->first;
+  unsigned order = it->second;
+  GL_ASSERT(slice.offset + slice.size <= offset + block_size(order), "freeing a slice at %u that isn't allocated", slice.offset);
+  a.allocated.erase(it);
+
+  _allocated -= block_size(order);
+  _requested -= slice.size;
+
+  while (order < _max_order) {
+    size_t buddy = offset ^ block_size(order);
+    if (!a.free[order].erase(buddy)) {
+      break;
+    }
+    offset = std::min(offset, buddy);
+    ++order;
+  }
+  a.free[order].insert(offset);
+}
+
+
+BufferHeap::Arena& BufferHeap::arena(BufferSlice const& slice) {
+  for (auto& a : _arenas) {
+    if (a.buffer.get() == slice.buffer) {
+      return a;
+    }
+  }
+  throw gl::exception("slice of buffer %u doesn't belong to this BufferHeap", slice.buffer ? slice.buffer->name() : 0);
+}
+
+
+BufferHeapStats BufferHeap::stats() const {
+  BufferHeapStats stats;
+  stats.capacity = _arenas.size() * _buffer_size;
+  stats.allocated = _allocated;
+  stats.requested = _requested;
+  stats.backing_buffers = _arenas.size();
+
+  for (auto const& a : _arenas) {
+    stats.allocations += a.allocated.size();
+    for (unsigned order = 0; order <= _max_order; ++order) {
+      if (!a.free[order].empty()) {
+        stats.free_ranges += a.free[order].size();
+        stats.largest_free = std::max(stats.largest_free, block_size(order));
+      }
+    }
+  }
+  return stats;
+}
+
+std::vector<Buffer const*> BufferHeap::buffers() const {
+  std::vector<Buffer const*> buffers;
+  for (auto const& a : _arenas) {
+    buffers.push_back(a.buffer.get());
+  }
+  return buffers;
+}
+
+
+} // namespace gl
@@ -0,0 +1,118 @@
+#ifndef UGLY_BUFFER_HEAP_H
+#define UGLY_BUFFER_HEAP_H
+
+#include "gl_type.h"
+#include "buffer.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace gl {
+
+
+struct BufferHeapStats {
+  size_t capacity { 0 };     // bytes in all backing Buffers
+  size_t allocated { 0 };    // bytes in allocated blocks, including rounding
+  size_t requested { 0 };    // bytes asked for by live slices
+  size_t allocations { 0 };  // live slices
+  size_t free_ranges { 0 };  // free blocks, after merging buddies
+  size_t largest_free { 0 }; // the biggest free block
+  size_t backing_buffers { 0 };
+
+  size_t free() const { return capacity - allocated; }
+
+  /**
+   * @brief 0 when all free space is one block, approaching 1 as it's split
+   * into many small ones.
+   **/
+  double fragmentation() const {
+    return free() ? 1.0 - double(largest_free) / double(free()) : 0.0;
+  }
+};
+
+
+/**
+ * @brief a buddy allocator handing out BufferSlices of a few large Buffers,
+ * so that thousands of small meshes share a handful of GL buffers (and, if
+ * their vertex formats match, one VertexArray per buffer).
+ *
+ * Blocks are powers of two from `min_block` up to `buffer_size`; a request
+ * gets the smallest block it fits in, and freed blocks merge with their
+ * buddies. A block is aligned to its own size. When no backing Buffer has
+ * room, another of `buffer_size` bytes is created.
+ **/
+class BufferHeap {
+  public:
+    /**
+     * @brief `buffer_size` and `min_block` must be powers of two.
+     **/
+    BufferHeap(size_t buffer_size = 16 << 20, size_t min_block = 256, GLenum usage = GL_STATIC_DRAW);
+    ~BufferHeap();
+    BufferHeap(BufferHeap const&) = delete;
+    BufferHeap& operator=(BufferHeap const&) = delete;
+
+  public:
+    /**
+     * @brief allocate `size` bytes whose offset is a multiple of `alignment`
+     * (e.g. a vertex stride, so the slice can be drawn by its first vertex).
+     **/
+    BufferSlice allocate(size_t size, size_t alignment = 1);
+
+    /**
+     * @brief allocate room for `values` and upload them.
+     **/
+    template<typename T>
+    BufferSlice store(std::vector<T> const& values, size_t alignment = sizeof(T)) {
+      auto slice = allocate(values.size() * sizeof(T), alignment);
+      write(slice, values.data());
+      return slice;
+    }
+
+    /**
+     * @brief upload slice.size bytes of `data` into the slice.
+     **/
+    void write(BufferSlice const& slice, void const* data);
+
+    /**
+     * @brief return a slice to the heap. The slice must come from this heap.
+     **/
+    void free(BufferSlice const& slice);
+
+  public:
+    BufferHeapStats stats() const;
+
+    size_t buffer_size() const { return _buffer_size; }
+    size_t min_block() const { return _min_block; }
+
+    /**
+     * @brief the backing Buffers, e.g. to set up one VertexArray for each.
+     **/
+    std::vector<Buffer const*> buffers() const;
+
+  private:
+    struct Arena {
+      std::unique_ptr<Buffer> buffer;
+      std::vector<std::set<size_t>> free;  // block offsets by order
+      std::map<size_t, unsigned> allocated; // block offset -> order
+    };
+
+    Arena& arena(BufferSlice const&);
+    size_t block_size(unsigned order) const { return _min_block << order; }
+
+  private:
+    size_t _buffer_size;
+    size_t _min_block;
+    unsigned _max_order;
+    GLenum _usage;
+    std::vector<Arena> _arenas;
+    size_t _allocated { 0 };
+    size_t _requested { 0 };
+
+};
+
+
+} // namespace gl
+
+#endif
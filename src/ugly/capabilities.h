@@ -0,0 +1,123 @@
+#ifndef UGLY_CAPABILITIES_H
+#define UGLY_CAPABILITIES_H
+
+#include "gl_type.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace gl {
+
+
+// Implementation limits that can't change over the lifetime of a context.
+// X(param, field)
+#define UGLY_CAPABILITY_LIMITS(X) \
+  X(GL_CONTEXT_FLAGS, context_flags) \
+  X(GL_MAX_3D_TEXTURE_SIZE, max_3d_texture_size) \
+  X(GL_MAX_ARRAY_TEXTURE_LAYERS, max_array_texture_layers) \
+  X(GL_MAX_CLIP_DISTANCES, max_clip_distances) \
+  X(GL_MAX_COLOR_TEXTURE_SAMPLES, max_color_texture_samples) \
+  X(GL_MAX_COMBINED_FRAGMENT_UNIFORM_COMPONENTS, max_combined_fragment_uniform_components) \
+  X(GL_MAX_COMBINED_GEOMETRY_UNIFORM_COMPONENTS, max_combined_geometry_uniform_components) \
+  X(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, max_combined_texture_image_units) \
+  X(GL_MAX_COMBINED_UNIFORM_BLOCKS, max_combined_uniform_blocks) \
+  X(GL_MAX_COMBINED_VERTEX_UNIFORM_COMPONENTS, max_combined_vertex_uniform_components) \
+  X(GL_MAX_CUBE_MAP_TEXTURE_SIZE, max_cube_map_texture_size) \
+  X(GL_MAX_DEPTH_TEXTURE_SAMPLES, max_depth_texture_samples) \
+  X(GL_MAX_DRAW_BUFFERS, max_draw_buffers) \
+  X(GL_MAX_DUAL_SOURCE_DRAW_BUFFERS, max_dual_source_draw_buffers) \
+  X(GL_MAX_ELEMENTS_INDICES, max_elements_indices) \
+  X(GL_MAX_ELEMENTS_VERTICES, max_elements_vertices) \
+  X(GL_MAX_FRAGMENT_INPUT_COMPONENTS, max_fragment_input_components) \
+  X(GL_MAX_FRAGMENT_UNIFORM_COMPONENTS, max_fragment_uniform_components) \
+  X(GL_MAX_FRAGMENT_UNIFORM_VECTORS, max_fragment_uniform_vectors) \
+  X(GL_MAX_FRAGMENT_UNIFORM_BLOCKS, max_fragment_uniform_blocks) \
+  X(GL_MAX_GEOMETRY_INPUT_COMPONENTS, max_geometry_input_components) \
+  X(GL_MAX_GEOMETRY_OUTPUT_COMPONENTS, max_geometry_output_components) \
+  X(GL_MAX_GEOMETRY_TEXTURE_IMAGE_UNITS, max_geometry_texture_image_units) \
+  X(GL_MAX_GEOMETRY_UNIFORM_BLOCKS, max_geometry_uniform_blocks) \
+  X(GL_MAX_GEOMETRY_UNIFORM_COMPONENTS, max_geometry_uniform_components) \
+  X(GL_MAX_INTEGER_SAMPLES, max_integer_samples) \
+  X(GL_MAX_RECTANGLE_TEXTURE_SIZE, max_rectangle_texture_size) \
+  X(GL_MAX_RENDERBUFFER_SIZE, max_renderbuffer_size) \
+  X(GL_MAX_SAMPLE_MASK_WORDS, max_sample_mask_words) \
+  X(GL_MAX_TEXTURE_BUFFER_SIZE, max_texture_buffer_size) \
+  X(GL_MAX_TEXTURE_IMAGE_UNITS, max_texture_image_units) \
+  X(GL_MAX_TEXTURE_SIZE, max_texture_size) \
+  X(GL_MAX_UNIFORM_BUFFER_BINDINGS, max_uniform_buffer_bindings) \
+  X(GL_MAX_UNIFORM_BLOCK_SIZE, max_uniform_block_size) \
+  X(GL_MAX_VARYING_VECTORS, max_varying_vectors) \
+  X(GL_MAX_VERTEX_ATTRIBS, max_vertex_attribs) \
+  X(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, max_vertex_texture_image_units) \
+  X(GL_MAX_VERTEX_UNIFORM_COMPONENTS, max_vertex_uniform_components) \
+  X(GL_MAX_VERTEX_UNIFORM_VECTORS, max_vertex_uniform_vectors) \
+  X(GL_MAX_VERTEX_OUTPUT_COMPONENTS, max_vertex_output_components) \
+  X(GL_MAX_VERTEX_UNIFORM_BLOCKS, max_vertex_uniform_blocks) \
+  X(GL_MAX_VIEWPORTS, max_viewports) \
+  X(GL_NUM_SHADER_BINARY_FORMATS, num_shader_binary_formats) \
+  X(GL_SUBPIXEL_BITS, subpixel_bits) \
+  X(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, uniform_buffer_offset_alignment) \
+  X(GL_VIEWPORT_SUBPIXEL_BITS, viewport_subpixel_bits)
+
+// Signed limits.
+#define UGLY_CAPABILITY_SIGNED_LIMITS(X) \
+  X(GL_MAX_PROGRAM_TEXEL_OFFSET, max_program_texel_offset) \
+  X(GL_MIN_PROGRAM_TEXEL_OFFSET, min_program_texel_offset)
+
+
+/**
+ * @brief an immutable snapshot of a Context's version, limits and extensions,
+ * captured once when the Context is created. Reading it never calls into GL.
+ **/
+struct Capabilities {
+  unsigned major_version { 0 };
+  unsigned minor_version { 0 };
+
+#define X(param, field) unsigned field { 0 };
+  UGLY_CAPABILITY_LIMITS(X)
+#undef X
+
+#define X(param, field) int field { 0 };
+  UGLY_CAPABILITY_SIGNED_LIMITS(X)
+#undef X
+
+  uint64_t max_server_wait_timeout { 0 };
+
+  // 0 where the version doesn't have them.
+  unsigned max_atomic_counter_buffer_bindings { 0 };   // 4.2
+  unsigned max_shader_storage_buffer_bindings { 0 };   // 4.3
+  unsigned shader_storage_buffer_offset_alignment { 0 };
+  uint64_t max_shader_storage_block_size { 0 };
+
+  std::unordered_set<std::string> extensions;
+  std::vector<int> compressed_texture_formats;
+  std::vector<int> program_binary_formats;
+
+  bool has_extension(std::string const& name) const {
+    return extensions.count(name) != 0;
+  }
+
+  /**
+   * @brief true if the context version is at least major.minor
+   **/
+  bool version_at_least(unsigned major, unsigned minor) const {
+    return major_version > major || (major_version == major && minor_version >= minor);
+  }
+};
+
+
+namespace detail {
+
+/**
+ * @brief the Capabilities of the Context current on this thread, or nullptr
+ * if there isn't one.
+ **/
+Capabilities const* current_capabilities();
+
+}
+
+
+} // namespace gl
+
+#endif
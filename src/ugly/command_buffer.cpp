@@ -0,0 +1,319 @@
+#include "command_buffer.h"
+#include "context.h"
+#include "buffer.h"
+#include "framebuffer.h"
+#include "program.h"
+#include "uniform.h"
+#include "vertex_array.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace gl {
+
+
+namespace {
+
+const size_t block_size = 64 * 1024;
+
+enum Op : uint32_t {
+  OP_FRAMEBUFFER = 0,
+  OP_CLEAR,
+  OP_RENDER_STATE,
+  OP_DRAW,
+  OP_UNIFORM,
+  OP_UPLOAD,
+};
+
+// Every record starts with a Header, and is padded to 8 bytes.
+struct Header {
+  uint32_t op;
+  uint32_t size; // including the header and any trailing data
+};
+
+struct FramebufferCommand {
+  GLuint name;
+  float viewport[4];
+};
+
+struct ClearCommand {
+  GLbitfield mask;
+  float color[4];
+};
+
+struct DrawCommand {
+  GLuint program;
+  GLuint vertex_array;
+  GLenum mode;
+  GLint first;
+  GLsizei count;
+  GLsizei instances; // 0 for a plain draw
+};
+
+// values follow
+struct UniformCommand {
+  detail::UniformCache* cache;  // the Program's, which stays put if it moves
+  GLuint program;
+  GLint location;
+  uint32_t kind;
+  uint32_t transpose;
+};
+
+// data follows
+struct UploadCommand {
+  GLuint buffer;
+  uint32_t padding;
+  uint64_t offset;
+  uint64_t size;
+};
+
+static_assert(std::is_trivially_copyable<RenderState>::value, "RenderState is recorded by copy");
+
+
+// kind = 4 * type + (components - 1), or UNIFORM_MAT4
+enum UniformKind : uint32_t {
+  UNIFORM_FLOAT = 0,
+  UNIFORM_INT = 4,
+  UNIFORM_UINT = 8,
+  UNIFORM_MAT4 = 12,
+};
+
+template<typename T> uint32_t uniform_type();
+template<> uint32_t uniform_type<GLfloat>() { return UNIFORM_FLOAT; }
+template<> uint32_t uniform_type<GLint>() { return UNIFORM_INT; }
+template<> uint32_t uniform_type<GLuint>() { return UNIFORM_UINT; }
+
+inline size_t padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+template<typename T>
+inline T const& payload(uint8_t const* record) {
+  return *reinterpret_cast<T const*>(record + sizeof(Header));
+}
+
+inline void const* trailing(uint8_t const* record, size_t command_size) {
+  return record + sizeof(Header) + command_size;
+}
+
+
+void set_uniform(UniformCommand const& u, void const* values) {
+  auto f = static_cast<GLfloat const*>(values);
+  auto i = static_cast<GLint const*>(values);
+  auto ui = static_cast<GLuint const*>(values);
+  auto& cache = *u.cache;
+
+  switch (u.kind) {
+    case UNIFORM_FLOAT + 0: uniform<GLfloat>(u.program, cache, u.location).set(f[0]); break;
+    case UNIFORM_FLOAT + 1: uniform2<GLfloat>(u.program, cache, u.location).set(f[0], f[1]); break;
+    case UNIFORM_FLOAT + 2: uniform3<GLfloat>(u.program, cache, u.location).set(f[0], f[1], f[2]); break;
+    case UNIFORM_FLOAT + 3: uniform4<GLfloat>(u.program, cache, u.location).set(f[0], f[1], f[2], f[3]); break;
+    case UNIFORM_INT + 0: uniform<GLint>(u.program, cache, u.location).set(i[0]); break;
+    case UNIFORM_INT + 1: uniform2<GLint>(u.program, cache, u.location).set(i[0], i[1]); break;
+    case UNIFORM_INT + 2: uniform3<GLint>(u.program, cache, u.location).set(i[0], i[1], i[2]); break;
+    case UNIFORM_INT + 3: uniform4<GLint>(u.program, cache, u.location).set(i[0], i[1], i[2], i[3]); break;
+    case UNIFORM_UINT + 0: uniform<GLuint>(u.program, cache, u.location).set(ui[0]); break;
+    case UNIFORM_UINT + 1: uniform2<GLuint>(u.program, cache, u.location).set(ui[0], ui[1]); break;
+    case UNIFORM_UINT + 2: uniform3<GLuint>(u.program, cache, u.location).set(ui[0], ui[1], ui[2]); break;
+    case UNIFORM_UINT + 3: uniform4<GLuint>(u.program, cache, u.location).set(ui[0], ui[1], ui[2], ui[3]); break;
+    case UNIFORM_MAT4:
+      uniform_mat4(u.program, cache, u.location).set(f, u.transpose != 0);
+      break;
+    default:
+      throw gl::exception("bad uniform kind %u in CommandBuffer", u.kind);
+  }
+}
+
+}
+
+
+CommandBuffer::CommandBuffer() {}
+
+CommandBuffer::~CommandBuffer() {}
+
+CommandBuffer::CommandBuffer(CommandBuffer&&) = default;
+
+CommandBuffer& CommandBuffer::operator=(CommandBuffer&&) = default;
+
+
+void CommandBuffer::push(uint32_t op, void const* command, size_t size, void const* data, size_t data_size) {
+  size_t record_size = padded(sizeof(Header) + size + data_size);
+  GL_ASSERT(record_size <= UINT32_MAX, "CommandBuffer record of %u bytes is too big", record_size);
+
+  // Use the current block if it fits, then the next (left over from before a
+  // reset), and otherwise insert a new one; big uploads get a block to themselves.
+  if (!_blocks.empty() && _blocks[_current].used + record_size > _blocks[_current].size) {
+    ++_current;
+  }
+  if (_current == _blocks.size() || _blocks[_current].size < record_size) {
+    auto bytes = std::max(block_size, record_size);
+    _blocks.insert(_blocks.begin() + _current, Block { std::unique_ptr<uint64_t[]>(new uint64_t[bytes / 8]), bytes, 0 });
+  }
+
+  auto& block = _blocks[_current];
+  auto record = reinterpret_cast<uint8_t*>(block.data.get()) + block.used;
+  Header header { op, uint32_t(record_size) };
+  std::memcpy(record, &header, sizeof(Header));
+  std::memcpy(record + sizeof(Header), command, size);
+  if (data_size) {
+    std::memcpy(record + sizeof(Header) + size, data, data_size);
+  }
+  block.used += record_size;
+  ++_count;
+}
+
+void CommandBuffer::reset() {
+  for (auto& block : _blocks) {
+    block.used = 0;
+  }
+  _current = 0;
+  _count = 0;
+}
+
+
+void CommandBuffer::framebuffer(Framebuffer const& framebuffer) {
+  auto const& v = framebuffer.viewport();
+  FramebufferCommand command { framebuffer.name(), { v.x, v.y, v.width, v.height } };
+  push(OP_FRAMEBUFFER, &command, sizeof(command));
+}
+
+void CommandBuffer::default_framebuffer(Viewport const& v) {
+  FramebufferCommand command { 0, { v.x, v.y, v.width, v.height } };
+  push(OP_FRAMEBUFFER, &command, sizeof(command));
+}
+
+void CommandBuffer::clear(GLenum mask, color const& c) {
+  ClearCommand command { mask, { c.r, c.g, c.b, c.a } };
+  push(OP_CLEAR, &command, sizeof(command));
+}
+
+void CommandBuffer::apply(RenderState const& state) {
+  push(OP_RENDER_STATE, &state, sizeof(state));
+}
+
+void CommandBuffer::draw(Program const& program, VertexArray const& vao, GLenum mode, size_t count, size_t first /* = 0 */) {
+  DrawCommand command { program.name(), vao.name(), mode, GLint(first), GLsizei(count), 0 };
+  push(OP_DRAW, &command, sizeof(command));
+}
+
+void CommandBuffer::draw(Program const& program, VertexArray const& vao) {
+  draw(program, vao, vao.mode(), vao.count());
+}
+
+void CommandBuffer::draw_instanced(Program const& program, VertexArray const& vao, size_t instance_count, GLenum mode, size_t count, size_t first /* = 0 */) {
+  DrawCommand command { program.name(), vao.name(), mode, GLint(first), GLsizei(count), GLsizei(instance_count) };
+  push(OP_DRAW, &command, sizeof(command));
+}
+
+
+void CommandBuffer::push_uniform(Program const& program, GLint location, uint32_t kind, void const* values, size_t size) {
+  UniformCommand command { program._uniform_cache.get(), program.name(), location, kind, 0 };
+  push(OP_UNIFORM, &command, sizeof(command), values, size);
+}
+
+template<typename... T>
+void CommandBuffer::uniform(Program const& program, GLint location, T... values) {
+  using U = typename std::common_type<T...>::type;
+  U const array[] = { values... };
+  push_uniform(program, location, uniform_type<U>() + sizeof...(T) - 1, array, sizeof(array));
+}
+
+template<typename... T>
+void CommandBuffer::uniform(Program const& program, GLint location, vec<T...> const& value) {
+  using U = typename std::common_type<T...>::type;
+  push_uniform(program, location, uniform_type<U>() + sizeof...(T) - 1, &value, sizeof(U) * sizeof...(T));
+}
+
+void CommandBuffer::uniform_matrix4(Program const& program, GLint location, GLfloat const* value, bool transpose) {
+  UniformCommand command { program._uniform_cache.get(), program.name(), location, UNIFORM_MAT4, transpose };
+  push(OP_UNIFORM, &command, sizeof(command), value, 16 * sizeof(GLfloat));
+}
+
+
+void CommandBuffer::upload(Buffer const& buffer, size_t offset, size_t size, void const* data) {
+  UploadCommand command { buffer.name(), 0, offset, size };
+  push(OP_UPLOAD, &command, sizeof(command), data, size);
+}
+
+
+void CommandBuffer::replay(Context& context, StateCache& state) const {
+  GLuint framebuffer = 0;
+  Viewport viewport = context.viewport();
+
+  for (size_t b = 0; b < _blocks.size() && b <= _current; ++b) {
+    auto const& block = _blocks[b];
+    auto p = reinterpret_cast<uint8_t const*>(block.data.get());
+    auto end = p + block.used;
+
+    while (p < end) {
+      auto const& header = *reinterpret_cast<Header const*>(p);
+
+      switch (header.op) {
+        case OP_FRAMEBUFFER: {
+          auto const& c = payload<FramebufferCommand>(p);
+          framebuffer = c.name;
+          viewport = Viewport(c.viewport[0], c.viewport[1], c.viewport[2], c.viewport[3]);
+          break;
+        }
+        case OP_CLEAR: {
+          auto const& c = payload<ClearCommand>(p);
+          state.bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+          GL_CALL(glClearColor(c.color[0], c.color[1], c.color[2], c.color[3]));
+          GL_CALL(glClear(c.mask));
+          break;
+        }
+        case OP_RENDER_STATE: {
+          context.apply(payload<RenderState>(p));
+          break;
+        }
+        case OP_DRAW: {
+          auto const& c = payload<DrawCommand>(p);
+          state.bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+          state.viewport(viewport);
+          state.use_program(c.program);
+          state.bind_vertex_array(c.vertex_array);
+          if (c.instances) {
+            GL_CALL(glDrawArraysInstanced(c.mode, c.first, c.count, c.instances));
+          } else {
+            GL_CALL(glDrawArrays(c.mode, c.first, c.count));
+          }
+          break;
+        }
+        case OP_UNIFORM: {
+          set_uniform(payload<UniformCommand>(p), trailing(p, sizeof(UniformCommand)));
+          break;
+        }
+        case OP_UPLOAD: {
+          auto const& c = payload<UploadCommand>(p);
+          state.bind_buffer(GL_COPY_WRITE_BUFFER, c.buffer);
+          GL_CALL(glBufferSubData(GL_COPY_WRITE_BUFFER, c.offset, c.size, trailing(p, sizeof(UploadCommand))));
+          break;
+        }
+        default:
+          throw gl::exception("bad CommandBuffer op %u", header.op);
+      }
+
+      p += header.size;
+    }
+  }
+}
+
+
+#define INSTANTIATE(...) \
+  template void CommandBuffer::uniform<__VA_ARGS__>(Program const&, GLint, __VA_ARGS__); \
+  template void CommandBuffer::uniform<__VA_ARGS__>(Program const&, GLint, vec<__VA_ARGS__> const&);
+#define INSTANTIATE_TYPE(T) \
+  template void CommandBuffer::uniform<T>(Program const&, GLint, T); \
+  INSTANTIATE(T, T); \
+  INSTANTIATE(T, T, T); \
+  INSTANTIATE(T, T, T, T);
+
+INSTANTIATE_TYPE(GLfloat);
+INSTANTIATE_TYPE(GLint);
+INSTANTIATE_TYPE(GLuint);
+#undef INSTANTIATE
+#undef INSTANTIATE_TYPE
+
+
+} // namespace gl
@@ -0,0 +1,118 @@
+#ifndef UGLY_COMMAND_BUFFER_H
+#define UGLY_COMMAND_BUFFER_H
+
+#include "gl_type.h"
+#include "render_state.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+
+class Buffer;
+class Context;
+class Framebuffer;
+class Program;
+class StateCache;
+class VertexArray;
+
+
+/**
+ * @brief a list of draws, uniform updates, render state changes and buffer
+ * uploads, recorded without a GL context and replayed later with
+ * Context::execute().
+ *
+ * Recording never calls into GL, so any thread can fill a CommandBuffer; the
+ * objects involved only need to exist, and uniform locations have to be
+ * looked up beforehand. Commands are small POD records packed into memory the
+ * CommandBuffer owns, so give each recording thread its own CommandBuffer and
+ * hand them to the Context's thread once they're complete. reset() keeps the
+ * memory for the next frame.
+ *
+ * Objects are recorded by name, and must outlive the replay. Uniforms also
+ * record the Program's cache of uniform values, so that they're set on replay
+ * only if changed. The cache stays where it is when its Program is moved, so
+ * Programs may move, e.g. in a growing std::vector, between recording and
+ * replay.
+ **/
+class CommandBuffer {
+  public:
+    CommandBuffer();
+    ~CommandBuffer();
+    CommandBuffer(CommandBuffer&&);
+    CommandBuffer& operator=(CommandBuffer&&);
+    CommandBuffer(CommandBuffer const&) = delete;
+    CommandBuffer& operator=(CommandBuffer const&) = delete;
+
+  public: // target
+    /**
+     * @brief send later clears and draws to a Framebuffer, using its viewport.
+     **/
+    void framebuffer(Framebuffer const&);
+
+    /**
+     * @brief send later clears and draws to the Context's own framebuffer.
+     * This is the target when a replay starts.
+     **/
+    void default_framebuffer(Viewport const&);
+
+  public: // drawing
+    void clear(GLenum mask, color const& clear_color);
+    void apply(RenderState const&);
+    void draw(Program const&, VertexArray const&, GLenum mode, size_t count, size_t first = 0);
+    void draw(Program const&, VertexArray const&);
+    void draw_instanced(Program const&, VertexArray const&, size_t instance_count, GLenum mode, size_t count, size_t first = 0);
+
+  public: // uniforms, set with glProgramUniform* unless unchanged
+    template<typename... T>
+    void uniform(Program const&, GLint location, T... values);
+
+    template<typename... T>
+    void uniform(Program const&, GLint location, vec<T...> const& value);
+
+    void uniform_matrix4(Program const&, GLint location, GLfloat const* value, bool transpose = false);
+
+  public: // buffer uploads; the data is copied when recorded
+    void upload(Buffer const&, size_t offset, size_t size, void const* data);
+
+    template<typename T>
+    void upload(Buffer const& buffer, std::vector<T> const& data, size_t offset = 0) {
+      upload(buffer, offset, data.size() * sizeof(T), data.data());
+    }
+
+  public:
+    /**
+     * @brief drop every command, keeping the memory.
+     **/
+    void reset();
+
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+
+  private:
+    friend class Context;
+
+    struct Block {
+      std::unique_ptr<uint64_t[]> data;
+      size_t size;  // bytes
+      size_t used;  // bytes
+    };
+
+    void push(uint32_t op, void const* command, size_t size, void const* data = nullptr, size_t data_size = 0);
+    void push_uniform(Program const&, GLint location, uint32_t kind, void const* values, size_t size);
+
+    void replay(Context&, StateCache&) const;
+
+  private:
+    std::vector<Block> _blocks;
+    size_t _current { 0 };
+    size_t _count { 0 };
+
+};
+
+
+} // namespace gl
+
+#endif
@@ -1,4 +1,5 @@
 #include "context.h"
+#include "context_impl.h"
 
 #include <set>
 #include <map>
@@ -8,9 +9,11 @@
 #include <functional>
 
 #include "buffer.h"
+#include "command_buffer.h"
 #include "program.h"
 #include "texture.h"
 #include "vertex_array.h"
+#include "enum.h"
 
 
 namespace gl {
@@ -18,43 +21,12 @@ namespace gl {
 
 
 
-// My policy with the impl so far is only to forward function calls where I actually
-// need polymorphism. Mostly, I'll use impl class as an opaque data storage type.
-// And I'm using pimpl at all, rather than pure virtual interface inheritance,
-// because:
-//   -  I want users to be able to put the concrete types on their stacks
-//   -  I don't want to write factories all over the place
-//   -  There's no intention to have multiple implementations of most things
-//       (I mean, it's a wrapper...)
-//   -  I'm trying to avoid future ABI compatibility issues
-//   -  It's faster  :trollface:
-
-class Context_impl {
-  public:
-    Context_impl(Context& context, void * handle);
-    virtual ~Context_impl() =0;
-
-
-  public:
-    virtual void make_current() {}
-    virtual bool current() const { return false; }
-    void on_made_not_current();
-
-  public:
-    GLbitfield _clear_mask { GL_COLOR_BUFFER_BIT };
-
-  protected:
-    Context& _context;
-    void *_handle { nullptr };
-};
-
-
 class MonoContext_impl : public Context_impl {
   private:
     static MonoContext_impl* current_context;
 
   public:
-    MonoContext_impl(Context& context, void *);
+    MonoContext_impl(Context& context, void *, OS_Bridge const&);
     ~MonoContext_impl();
 
   public:
@@ -66,11 +38,16 @@ class MonoContext_impl : public Context_impl {
 
 class MultiContext_impl : public Context_impl {
   private:
-    static std::map<std::thread::id, MultiContext_impl*> current_context;
-    static std::recursive_mutex current_context_lock;
+    // Every thread that owns a MultiContext registers the address of its
+    // thread-local slot here, so that a context destroyed on a foreign thread
+    // can still clear it. Only construction, destruction and thread exit lock;
+    // make_current() and current() never do.
+    static std::map<std::thread::id, Slot*> thread_slots;
+    static std::mutex thread_slots_lock;
+    static void register_thread();
 
   public:
-    MultiContext_impl(MultiContext& context, void *);
+    MultiContext_impl(MultiContext& context, void *, OS_Bridge const&);
     ~MultiContext_impl();
 
   public:
@@ -84,10 +61,12 @@ class MultiContext_impl : public Context_impl {
 
 
 
+thread_local Context_impl::Slot Context_impl::_current_on_thread { nullptr };
+
 MonoContext_impl* MonoContext_impl::current_context { 0 };
 
-std::map<std::thread::id, MultiContext_impl*> MultiContext_impl::current_context;
-std::recursive_mutex MultiContext_impl::current_context_lock;
+std::map<std::thread::id, Context_impl::Slot*> MultiContext_impl::thread_slots;
+std::mutex MultiContext_impl::thread_slots_lock;
 
 
 
@@ -159,23 +138,339 @@ inline std::vector<int> get(Context const& context, GLenum param, size_t size) {
 
 
 unsigned Context::major_version() const {
-  return get<unsigned>(GL_MAJOR_VERSION);
+  return _impl->_capabilities.major_version;
 }
 
 unsigned Context::minor_version() const {
-  return get<unsigned>(GL_MINOR_VERSION);
+  return _impl->_capabilities.minor_version;
+}
+
+Capabilities const& Context::capabilities() const {
+  return _impl->_capabilities;
+}
+
+void Context::capture_capabilities() {
+  auto& caps = _impl->_capabilities;
+  caps.major_version = get<unsigned>(GL_MAJOR_VERSION);
+  caps.minor_version = get<unsigned>(GL_MINOR_VERSION);
+
+#define X(param, field) caps.field = get<unsigned>(param);
+  UGLY_CAPABILITY_LIMITS(X)
+#undef X
+
+#define X(param, field) caps.field = get<int>(param);
+  UGLY_CAPABILITY_SIGNED_LIMITS(X)
+#undef X
+
+  caps.max_server_wait_timeout = get<int64_t>(GL_MAX_SERVER_WAIT_TIMEOUT);
+
+#ifdef GL_VERSION_4_2
+  if (caps.version_at_least(4, 2)) {
+    caps.max_atomic_counter_buffer_bindings = get<unsigned>(GL_MAX_ATOMIC_COUNTER_BUFFER_BINDINGS);
+  }
+#endif
+#ifdef GL_VERSION_4_3
+  if (caps.version_at_least(4, 3)) {
+    caps.max_shader_storage_buffer_bindings = get<unsigned>(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS);
+    caps.shader_storage_buffer_offset_alignment = get<unsigned>(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT);
+    caps.max_shader_storage_block_size = get<int64_t>(GL_MAX_SHADER_STORAGE_BLOCK_SIZE);
+  }
+#endif
+
+  unsigned extension_count = get<unsigned>(GL_NUM_EXTENSIONS);
+  for (unsigned i = 0; i < extension_count; ++i) {
+    GL_CALL(auto extension = glGetStringi(GL_EXTENSIONS, i));
+    caps.extensions.emplace(reinterpret_cast<const char*>(extension));
+  }
+
+  caps.compressed_texture_formats = get<GL_COMPRESSED_TEXTURE_FORMATS, GL_NUM_COMPRESSED_TEXTURE_FORMATS>();
+  caps.program_binary_formats = get<GL_PROGRAM_BINARY_FORMATS, GL_NUM_PROGRAM_BINARY_FORMATS>();
 }
 
 Context::~Context() {
+  // Either way the queue is closed: objects outliving the Context dispose of
+  // their names elsewhere, instead of queueing them for nobody.
+  if (Context_impl::current_on_thread() == _impl) {
+    _impl->_names.clear(_impl->_state);
+  } else if (auto leaked = _impl->_names.abandon()) {
+    logw("Context destroyed while not current: %zu names it queued or reserved are never deleted", leaked);
+  }
   delete _impl;
 }
 
 
+void Context_impl::make_current() {
+  if (_bridge.make_current) {
+    _bridge.make_current(_handle);
+  }
+  _current_on_thread.store(this, std::memory_order_relaxed);
+  detail::error_policy = _error_policy;
+  _names.flush(_state);
+}
+
 void Context_impl::on_made_not_current() {
 }
 
+void Context_impl::release_thread() {
+  if (current_on_thread() == this) {
+    _current_on_thread.store(nullptr, std::memory_order_relaxed);
+    detail::error_policy = ERROR_POLICY_CHECKED;
+  }
+}
+
+
+StateCache* detail::current_state() {
+  auto impl = Context_impl::current_on_thread();
+  return impl ? &impl->_state : nullptr;
+}
+
+Capabilities const* detail::current_capabilities() {
+  auto impl = Context_impl::current_on_thread();
+  return impl ? &impl->_capabilities : nullptr;
+}
+
+GLuint detail::BindingPoints::assign(std::string const& block, GLuint requested, unsigned limit) {
+  auto it = _bindings.find(block);
+  if (it != _bindings.end() && !requested) {
+    return it->second;
+  }
+  GLuint binding = requested;
+  if (binding) {
+    auto owner = _automatic.find(binding);
+    if (owner != _automatic.end() && owner->second != block) {
+      throw gl::exception("block %s asks for binding %u, which was given to block %s", block.c_str(), binding, owner->second.c_str());
+    }
+  } else {
+    binding = 1;
+    while (binding < _used.size() && _used[binding]) {
+      ++binding;
+    }
+    if (binding >= limit) {
+      throw gl::exception("no binding point left for block %s: all %u are taken", block.c_str(), limit);
+    }
+    _automatic.emplace(binding, block);
+  }
+  if (binding >= _used.size()) {
+    _used.resize(binding + 1);
+  }
+  _used[binding] = true;
+  if (it == _bindings.end()) {
+    _bindings.emplace(block, binding);
+  }
+  return binding;
+}
+
+GLuint Context::uniform_block_binding(std::string const& block) {
+  return _impl->_uniform_block_bindings.assign(block, 0, _impl->_capabilities.max_uniform_buffer_bindings);
+}
+
+GLuint Context::storage_block_binding(std::string const& block) {
+  return _impl->_storage_block_bindings.assign(block, 0, _impl->_capabilities.max_shader_storage_buffer_bindings);
+}
+
+
+detail::NamePool* detail::current_name_pool() {
+  auto impl = Context_impl::current_on_thread();
+  return impl ? &impl->_names : nullptr;
+}
+
+
+BindingStats const& Context::binding_stats() const {
+  return _impl->_state.stats();
+}
+
+void Context::reset_binding_stats() {
+  _impl->_state.reset_stats();
+}
+
+void Context::invalidate_state() {
+  _impl->_state.invalidate();
+  _impl->_render_state_known = false;
+  _impl->_capabilities_known = 0;
+}
+
+void Context::binding_policy(BindingPolicy policy) {
+  _impl->_state.policy(policy);
+}
+
+BindingPolicy Context::binding_policy() const {
+  return _impl->_state.policy();
+}
+
+
+void Context::apply(RenderState const& state) {
+  if (_impl->_render_state_known) {
+    state.apply(_impl->_render_state, ~_impl->_capabilities_known);
+  } else {
+    state.apply();
+    _impl->_render_state_known = true;
+  }
+  _impl->_render_state = state;
+  _impl->_capabilities_known = (1u << CAPABILITY_INDEX_MAX) - 1;
+
+  if (_impl->_verify_state) {
+    for (unsigned i = 0; i < CAPABILITY_INDEX_MAX; ++i) {
+      verify_enabled(CapabilityIndex(i));
+    }
+  }
+}
+
+RenderState const& Context::render_state() const {
+  return _impl->_render_state;
+}
+
+void Context::verify_state(bool verify) {
+  _impl->_verify_state = verify;
+}
+
+bool Context::verify_state() const {
+  return _impl->_verify_state;
+}
+
+
+void Context::set_enabled(GLenum capability, bool enabled) {
+  auto index = capability_index(capability);
+  if (index == CAPABILITY_INDEX_MAX) { // not tracked
+    if (enabled) { GL_CALL(glEnable(capability)); } else { GL_CALL(glDisable(capability)); }
+    return;
+  }
+
+  auto bit = 1u << index;
+  if ((_impl->_capabilities_known & bit) && _impl->_render_state.enabled(index) == enabled) {
+    if (_impl->_verify_state) {
+      verify_enabled(index);
+    }
+    return;
+  }
+
+  if (enabled) { GL_CALL(glEnable(capability)); } else { GL_CALL(glDisable(capability)); }
+  _impl->_render_state.set_enabled(index, enabled);
+  _impl->_capabilities_known |= bit;
+}
+
+bool Context::enabled(GLenum capability) const {
+  auto index = capability_index(capability);
+  if (index == CAPABILITY_INDEX_MAX) { // not tracked
+    GL_CALL(bool enabled = glIsEnabled(capability));
+    return enabled;
+  }
+
+  auto bit = 1u << index;
+  if (!(_impl->_capabilities_known & bit)) {
+    GL_CALL(bool enabled = glIsEnabled(capability));
+    _impl->_render_state.set_enabled(index, enabled);
+    _impl->_capabilities_known |= bit;
+    return enabled;
+  }
+
+  if (_impl->_verify_state) {
+    verify_enabled(index);
+  }
+  return _impl->_render_state.enabled(index);
+}
+
+void Context::verify_enabled(CapabilityIndex index) const {
+  auto capability = gl::capability(index);
+  GL_CALL(bool actual = glIsEnabled(capability));
+  bool cached = _impl->_render_state.enabled(index);
+  if (actual != cached) {
+    throw gl::exception("cached state says %s (%u) is %s, but it is %s", to_string(capability),
+      capability, cached ? "enabled" : "disabled", actual ? "enabled" : "disabled");
+  }
+}
+
+
+void Context::execute(CommandBuffer const& commands) {
+  if (!current()) {
+    throw gl::exception("can't execute commands on an inactive context");
+  }
+  commands.replay(*this, _impl->_state);
+}
+
+
+void Context::error_policy(ErrorPolicy policy) {
+  if (!current()) {
+    throw gl::exception("can't change the error policy of an inactive context");
+  }
+  auto previous = _impl->_error_policy;
+  if (policy == previous) {
+    return;
+  }
+
+  if (policy == ERROR_POLICY_DEBUG_CALLBACK) {
+#ifdef GL_VERSION_4_3
+    auto const& caps = _impl->_capabilities;
+    if (!caps.version_at_least(4, 3) && !caps.has_extension("GL_KHR_debug")) {
+      throw gl::exception("ERROR_POLICY_DEBUG_CALLBACK needs GL 4.3 or GL_KHR_debug");
+    }
+    GL_CALL(glDebugMessageCallback(detail::debug_callback, nullptr));
+    GL_CALL(glEnable(GL_DEBUG_OUTPUT));
+    GL_CALL(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+#else
+    throw gl::exception("ERROR_POLICY_DEBUG_CALLBACK needs GL 4.3 or GL_KHR_debug");
+#endif
+  } else if (previous == ERROR_POLICY_DEBUG_CALLBACK) {
+#ifdef GL_VERSION_4_3
+    GL_CALL(glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+    GL_CALL(glDisable(GL_DEBUG_OUTPUT));
+    GL_CALL(glDebugMessageCallback(nullptr, nullptr));
+#endif
+  }
+
+  _impl->_error_policy = policy;
+  detail::error_policy = policy;
+}
+
+ErrorPolicy Context::error_policy() const {
+  return _impl->_error_policy;
+}
+
+void Context::check_errors() {
+  if (_impl->_error_policy != ERROR_POLICY_OFF) {
+    detail::check_errors();
+  }
+}
+
+void Context::flush_deletions() {
+  _impl->_names.flush(_impl->_state);
+}
+
+size_t Context::pending_deletions() const {
+  return _impl->_names.pending();
+}
+
+
+void Context::memory_barrier(GLbitfield barriers /* = ~GLbitfield(0) */) {
+#ifdef GL_VERSION_4_2
+  if (_impl->_capabilities.version_at_least(4, 2)) {
+    GL_CALL(glMemoryBarrier(barriers));
+    return;
+  }
+#endif
+  throw gl::exception("glMemoryBarrier needs GL 4.2, this Context is %u.%u", major_version(), minor_version());
+}
+
+void Context::memory_barrier_by_region(GLbitfield barriers /* = ~GLbitfield(0) */) {
+#ifdef GL_VERSION_4_5
+  if (_impl->_capabilities.version_at_least(4, 5)) {
+    GL_CALL(glMemoryBarrierByRegion(barriers));
+    return;
+  }
+#endif
+  throw gl::exception("glMemoryBarrierByRegion needs GL 4.5, this Context is %u.%u", major_version(), minor_version());
+}
+
+
+void Context::end_frame() {
+  flush_deletions();
+  check_errors();
+}
+
 
 void Context::clear(GLenum mask) {
+  // Most loops clear once a frame, whether or not they call end_frame().
+  flush_deletions();
+  _impl->_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
   GL_CALL(glClearColor(_clear_color.r, _clear_color.g, _clear_color.b, _clear_color.a));
   GL_CALL(glClear(mask));
 }
@@ -183,40 +478,52 @@ void Context::clear(GLenum mask) {
 void Context::draw(Program const& program, VertexArray const& vao, GLenum mode, size_t count, size_t first /* = 0 */) {
   VertexArrayBindguard guard(vao);
   ProgramBindguard program_guard(program);
-  GL_CALL(glViewport(_viewport.x, _viewport.y, _viewport.width, _viewport.height));
+  _impl->_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+  _impl->_state.viewport(_viewport);
   GL_CALL(glDrawArrays(mode, (GLsizei)first, (GLsizei)count));
 }
 
 void Context::draw_instanced(Program const& program, VertexArray const& vao, size_t instance_count, GLenum mode, size_t count, size_t first /* = 0 */) {
   VertexArrayBindguard guard(vao);
   ProgramBindguard program_guard(program);
-  GL_CALL(glViewport(_viewport.x, _viewport.y, _viewport.width, _viewport.height));
+  _impl->_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+  _impl->_state.viewport(_viewport);
   GL_CALL(glDrawArraysInstanced(mode, (GLsizei)first, (GLsizei)count, (GLsizei)instance_count));
 }
 
 
 Context::Context() {}
 
-Context_impl::Context_impl(Context& context, void* handle): _context(context), _handle(handle) {}
+Context_impl::Context_impl(Context& context, void* handle, OS_Bridge const& bridge)
+  : _context(context)
+  , _handle(handle)
+  , _bridge(bridge)
+  {}
 
 Context_impl::~Context_impl() {
 }
 
-MonoContext_impl::MonoContext_impl(Context& context, void* handle): Context_impl(context, handle) {
+MonoContext_impl::MonoContext_impl(Context& context, void* handle, OS_Bridge const& bridge)
+  : Context_impl(context, handle, bridge) {
   make_current();
 }
 
 
-MonoContext::MonoContext(void* handle): Context() {
-  _impl = new MonoContext_impl(*this, handle);
+MonoContext::MonoContext(void* handle, OS_Bridge const& bridge): Context() {
+  _impl = new MonoContext_impl(*this, handle, bridge);
+  capture_capabilities();
 }
 
 
 void MonoContext_impl::make_current() {
+  if (current_context == this && current_on_thread() == this) {
+    return;
+  }
   if (current_context && current_context != this) {
     current_context->on_made_not_current();
   }
   current_context = this;
+  Context_impl::make_current();
 }
 
 bool MonoContext_impl::current() const {
@@ -228,47 +535,61 @@ MonoContext_impl::~MonoContext_impl() {
   if (current_context == this) {
     current_context = nullptr;
   }
+  release_thread();
 }
 
 
-MultiContext_impl::MultiContext_impl(MultiContext& context, void* handle)
-  : Context_impl(context, handle)
+MultiContext_impl::MultiContext_impl(MultiContext& context, void* handle, OS_Bridge const& bridge)
+  : Context_impl(context, handle, bridge)
   , _thread_id(std::this_thread::get_id())
 {
+  register_thread();
   make_current();
 }
 
+void MultiContext_impl::register_thread() {
+  struct Registration {
+    Registration() {
+      std::lock_guard<std::mutex> lock(thread_slots_lock);
+      thread_slots[std::this_thread::get_id()] = &_current_on_thread;
+    }
+    ~Registration() {
+      std::lock_guard<std::mutex> lock(thread_slots_lock);
+      thread_slots.erase(std::this_thread::get_id());
+    }
+  };
+  static thread_local Registration registration;
+  (void)registration;
+}
+
 void MultiContext_impl::make_current() {
   if (std::this_thread::get_id() != _thread_id) {
     throw gl::exception("attempt to make Context current on another thread");
   }
-  {
-    std::lock_guard<std::recursive_mutex> lock(current_context_lock);
-    auto& i = current_context[_thread_id]; 
-    if (i != this) {
-      if (i) {
-        i->on_made_not_current();
-      }
-      i = this;
+  auto previous = current_on_thread();
+  if (previous != this) {
+    if (previous) {
+      previous->on_made_not_current();
     }
+    Context_impl::make_current();
   }
-  Context_impl::make_current();
 }
 
 bool MultiContext_impl::current() const {
-  if (std::this_thread::get_id() != _thread_id) {
-    return false;
-  }
-  std::lock_guard<std::recursive_mutex> lock(current_context_lock);
-  auto it = current_context.find(_thread_id);
-  return it != current_context.end() && it->second == this;
+  // Only the owning thread can ever have stored this in its slot.
+  return current_on_thread() == this;
 }
 
 MultiContext_impl::~MultiContext_impl() {
-  std::lock_guard<std::recursive_mutex> lock(current_context_lock);
-  auto it = current_context.find(_thread_id);
-  if (it != current_context.end() && it->second == this) {
-    current_context.erase(it);
+  if (std::this_thread::get_id() == _thread_id) {
+    release_thread();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(thread_slots_lock);
+  auto it = thread_slots.find(_thread_id);
+  if (it != thread_slots.end()) {
+    Context_impl* expected = this;
+    it->second->compare_exchange_strong(expected, nullptr);
   }
 }
 
@@ -285,21 +606,28 @@ void Context::make_current() {
 MonoContext::~MonoContext() {}
 
 
+MultiContext::MultiContext(void* handle, OS_Bridge const& bridge): Context() {
+  _impl = new MultiContext_impl(*this, handle, bridge);
+  capture_capabilities();
+}
+
+MultiContext::~MultiContext() {}
+
+
 
 template<GLenum capability>
 void Context::enable() {
-  GL_CALL(glEnable(capability));
+  set_enabled(capability, true);
 }
 
 template<GLenum capability>
 void Context::disable() {
-  GL_CALL(glDisable(capability));
+  set_enabled(capability, false);
 }
 
 template<GLenum capability>
 bool Context::is_enabled() const {
-  auto rv = GL_CALL(glIsEnabled(capability));
-  return rv;
+  return enabled(capability);
 }
 
 template<GLenum param, GLenum size_key>
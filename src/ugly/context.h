@@ -2,13 +2,20 @@
 #define CONTEXT_H
 
 #include "gl_type.h"
+#include "capabilities.h"
 #include "generated_object.h"
 #include "framebuffer.h"
+#include "state_cache.h"
+#include "render_state.h"
 
 #include <functional>
 
 namespace gl {
 
+/**
+ * @brief hooks into the windowing system. If set, make_current is called with
+ * the Context's handle whenever the Context becomes current on a thread.
+ **/
 struct OS_Bridge {
   std::function<void(void*)> make_current;
 };
@@ -18,6 +25,7 @@ struct OS_Bridge {
 
 class Pipeline;
 class Buffer;
+class CommandBuffer;
 class Program;
 class Framebuffer;
 class Texture;
@@ -29,6 +37,12 @@ class Context : public BasicFramebuffer {
     Context();
 
   public:
+    /**
+     * @brief delete the names this Context queued for deletion, or generated
+     * ahead of use, if it's current on this thread. Otherwise they can't be
+     * deleted, and leak for as long as the objects' share group lives; a
+     * warning gives their number. Destroy a Context while it's current.
+     **/
     virtual ~Context() =0;
     Context(Context const&) = delete;
     Context& operator=(Context const&) = delete;
@@ -44,6 +58,11 @@ class Context : public BasicFramebuffer {
      **/
     unsigned minor_version() const;
 
+    /**
+     * @brief the limits and extensions captured when the Context was created
+     **/
+    Capabilities const& capabilities() const;
+
 
   public: // CURRENT CONTEXT
     /**
@@ -58,7 +77,127 @@ class Context : public BasicFramebuffer {
     bool current() const;
 
 
+  public: // BINDING STATE
+    /**
+     * @brief counts of binds issued to the driver vs. elided by the state cache.
+     **/
+    BindingStats const& binding_stats() const;
+    void reset_binding_stats();
+
+    /**
+     * @brief discard the cached bindings and render state. Call this after
+     * binding or setting anything directly through the GL API, while this
+     * Context is current.
+     **/
+    void invalidate_state();
+
+    /**
+     * @brief choose what Bindguards do when they go out of scope.
+     * See BindingPolicy; BINDING_LEAVE_BOUND issues the fewest GL calls.
+     **/
+    void binding_policy(BindingPolicy);
+    BindingPolicy binding_policy() const;
+
+    /**
+     * @brief the binding point of uniform blocks called `block`. Programs
+     * linked while this Context is current have each block without an explicit
+     * layout(binding = N) bound to the point for its name, the same in every
+     * Program, so bind a UniformBuffer there once and every Program sees it.
+     **/
+    GLuint uniform_block_binding(std::string const& block);
+
+    /**
+     * @brief the same for shader storage blocks (GL 4.3).
+     **/
+    GLuint storage_block_binding(std::string const& block);
+
+
+  public: // RENDER STATE
+    /**
+     * @brief make the fixed-function state match a RenderState. Only the GL
+     * calls for the parts that differ from the last RenderState applied are
+     * issued; the first apply (or the first after invalidate_state()) issues
+     * them all.
+     **/
+    void apply(RenderState const&);
+
+    /**
+     * @brief the last RenderState applied, including any enable()/disable()
+     * made since.
+     **/
+    RenderState const& render_state() const;
+
+    /**
+     * @brief when on, every answer or skipped call that relies on the cached
+     * capability bits is cross-checked with glIsEnabled, and a mismatch throws
+     * gl::exception. Slow; meant for tests and for hunting down raw glEnable
+     * calls that bypass the Context.
+     **/
+    void verify_state(bool);
+    bool verify_state() const;
+
+
+  public: // DEFERRED COMMANDS
+    /**
+     * @brief replay a CommandBuffer recorded on any thread. The Context must be
+     * current. Draws start out targeting this Context's framebuffer.
+     **/
+    void execute(CommandBuffer const&);
+
+
+  public: // ERRORS
+    /**
+     * @brief choose how GL errors are caught; see ErrorPolicy. The Context must
+     * be current.
+     **/
+    void error_policy(ErrorPolicy);
+    ErrorPolicy error_policy() const;
+
+    /**
+     * @brief throw gl::exception if any GL error was raised since the last
+     * check. Use it to close a scope under ERROR_POLICY_PER_FRAME. Does nothing
+     * under ERROR_POLICY_OFF.
+     **/
+    void check_errors();
+
+    /**
+     * @brief mark the end of a frame. Deletes the objects destroyed during it,
+     * as flush_deletions(), and checks for errors, as check_errors().
+     **/
+    void end_frame();
+
+    /**
+     * @brief glMemoryBarrier (GL 4.2): make what shaders wrote to storage
+     * buffers, images or atomic counters visible to the uses in `barriers`,
+     * e.g. GL_SHADER_STORAGE_BARRIER_BIT before another pass reads an SSBO,
+     * GL_BUFFER_UPDATE_BARRIER_BIT before reading it back. By default, all
+     * of them (GL_ALL_BARRIER_BITS).
+     **/
+    void memory_barrier(GLbitfield barriers = ~GLbitfield(0));
+
+    /**
+     * @brief glMemoryBarrierByRegion (GL 4.5), for fragment shaders that only
+     * read what was written for their own pixel.
+     **/
+    void memory_barrier_by_region(GLbitfield barriers = ~GLbitfield(0));
+
+    /**
+     * @brief delete, now, the GL objects made in this Context and since
+     * destroyed. Destroying a Buffer, Texture, Program, etc. only queues its
+     * name, on whichever thread that happens, so its memory stays allocated
+     * until the queue is deleted, in one call per kind of object: at
+     * end_frame(), clear(), make_current(), or once the queue grows long.
+     * Loops that do none of these once a frame must call end_frame() or this,
+     * while this Context is current. pending_deletions() only counts objects
+     * destroyed on this Context's thread.
+     **/
+    void flush_deletions();
+    size_t pending_deletions() const;
+
+
   public: // BasicFramebuffer
+    using BasicFramebuffer::draw;
+    using BasicFramebuffer::draw_instanced;
     void clear(GLenum mask) override;
     void draw(Program const&, VertexArray const&, GLenum mode, size_t count, size_t first = 0) override;
     void draw_instanced(Program const&, VertexArray const&, size_t instance_count, GLenum mode, size_t count, size_t first = 0) override;
@@ -70,6 +209,11 @@ class Context : public BasicFramebuffer {
     template<GLenum>
     void cull_face();
 
+    /**
+     * @brief enable/disable a capability. Calls that wouldn't change anything
+     * are skipped, and is_enabled() answers from the cache, querying the
+     * driver at most once per capability (or after invalidate_state()).
+     **/
     template<GLenum> void enable();
     template<GLenum> void disable();
     template<GLenum> bool is_enabled() const;
@@ -86,6 +230,14 @@ class Context : public BasicFramebuffer {
       return get<T>(param);
     }
 
+  protected:
+    void capture_capabilities();
+
+  private:
+    void set_enabled(GLenum capability, bool enabled);
+    bool enabled(GLenum capability) const;
+    void verify_enabled(CapabilityIndex) const;
+
   private:
     template<typename T>
     T get(GLenum) const;
@@ -115,7 +267,7 @@ template<> color Context::get<color>(GLenum) const;
  **/
 class MonoContext : public Context {
   public:
-    MonoContext(void*);
+    MonoContext(void*, OS_Bridge const& = OS_Bridge());
     ~MonoContext() override;
 };
 
@@ -129,7 +281,7 @@ class MonoContext : public Context {
  **/
 class MultiContext : public Context {
   public:
-    MultiContext(void*);
+    MultiContext(void*, OS_Bridge const& = OS_Bridge());
     ~MultiContext() override;
 };
 
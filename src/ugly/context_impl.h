@@ -0,0 +1,121 @@
+#ifndef UGLY_CONTEXT_IMPL_H
+#define UGLY_CONTEXT_IMPL_H
+
+// Internal header: not installed, only included by the library's own sources.
+
+#include "context.h"
+#include "state_cache.h"
+#include "render_state.h"
+#include "name_pool.h"
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gl {
+
+
+// My policy with the impl so far is only to forward function calls where I actually
+// need polymorphism. Mostly, I'll use impl class as an opaque data storage type.
+// And I'm using pimpl at all, rather than pure virtual interface inheritance,
+// because:
+//   -  I want users to be able to put the concrete types on their stacks
+//   -  I don't want to write factories all over the place
+//   -  There's no intention to have multiple implementations of most things
+//       (I mean, it's a wrapper...)
+//   -  I'm trying to avoid future ABI compatibility issues
+//   -  It's faster  :trollface:
+
+namespace detail {
+
+/**
+ * @brief throw gl::exception for anything the debug callback recorded or any
+ * raised error flag, clearing them.
+ **/
+void check_errors();
+
+/**
+ * @brief binding points handed out to blocks by name, so that every Program
+ * with a block called "Camera" reads it from the same binding.
+ *
+ * Reflection reports a block without layout(binding = N) at binding 0, so 0
+ * means "auto": a block explicitly at binding 0 gets its name's point like
+ * any other. Explicit bindings count from 1.
+ **/
+class BindingPoints {
+  public:
+    /**
+     * @brief the binding for `block`: `requested` if that's not 0 (an explicit
+     * layout(binding = N)), else the one it got before, else the lowest free
+     * one from 1 up, below `limit`. Throws if `requested` was handed out to
+     * another block automatically, since Programs already linked read that
+     * block there.
+     **/
+    GLuint assign(std::string const& block, GLuint requested, unsigned limit);
+
+  private:
+    std::unordered_map<std::string, GLuint> _bindings;
+    std::unordered_map<GLuint, std::string> _automatic;
+    std::vector<bool> _used;
+};
+
+#ifdef GL_VERSION_4_3
+void APIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+  GLsizei length, const GLchar* message, const void* user);
+#endif
+
+}
+
+
+class Context_impl {
+  public:
+    Context_impl(Context& context, void * handle, OS_Bridge const& bridge);
+    virtual ~Context_impl() =0;
+
+
+  public:
+    virtual void make_current();
+    virtual bool current() const { return false; }
+    void on_made_not_current();
+
+  public:
+    /**
+     * @brief the impl most recently made current on the calling thread.
+     **/
+    static Context_impl* current_on_thread() {
+      return _current_on_thread.load(std::memory_order_relaxed);
+    }
+
+  public:
+    GLbitfield _clear_mask { GL_COLOR_BUFFER_BIT };
+    StateCache _state;
+    detail::NamePool _names;
+    Capabilities _capabilities;
+    RenderState _render_state;
+    bool _render_state_known { false };      // the parameters, as a whole
+    uint32_t _capabilities_known { 0 };      // one bit per CapabilityIndex
+    bool _verify_state { false };
+    ErrorPolicy _error_policy { ERROR_POLICY_CHECKED };
+    detail::BindingPoints _uniform_block_bindings;
+    detail::BindingPoints _storage_block_bindings;
+
+  protected:
+    void release_thread();
+
+  protected:
+    Context& _context;
+    void *_handle { nullptr };
+    OS_Bridge _bridge;
+
+  protected:
+    // Atomic only so that a MultiContext destroyed on another thread can clear
+    // its owner's slot; the owning thread itself just does relaxed loads/stores.
+    using Slot = std::atomic<Context_impl*>;
+    static thread_local Slot _current_on_thread;
+};
+
+
+} // namespace gl
+
+#endif
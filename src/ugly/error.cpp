@@ -0,0 +1,106 @@
+#include "gl_type.h"
+
+namespace gl {
+
+
+thread_local ErrorPolicy detail::error_policy { ERROR_POLICY_CHECKED };
+thread_local bool detail::error_pending { false };
+
+
+namespace {
+
+// The first error the debug callback reported since the last throw.
+thread_local std::string pending_message;
+
+// Clear every error flag; the driver may have several set at once.
+GLenum drain_errors() {
+  GLenum first = glGetError();
+  if (first != GL_NO_ERROR) {
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; ++i) {}
+  }
+  return first;
+}
+
+const char* error_name(GLenum error) {
+  switch (error) {
+    case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
+    case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
+    case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+    case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
+    case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
+    default: return "unknown error";
+  }
+}
+
+}
+
+
+void detail::check_error(const char* call) {
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    loge("%s failed: %d", call, error);
+    throw gl::exception("gl call %s failed: %d", call, error);
+  }
+}
+
+void detail::log_error(const char* call) {
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    loge("%s failed: %d", call, error);
+  }
+}
+
+void detail::throw_pending_error(const char* call) {
+  std::string message;
+  message.swap(pending_message);
+  error_pending = false;
+  drain_errors();
+  throw gl::exception("gl call %s failed: %s", call, message);
+}
+
+
+namespace detail {
+
+/**
+ * @brief throw anything the debug callback recorded, or any raised error flag.
+ **/
+void check_errors() {
+  GLenum error = drain_errors();
+  if (error_pending) {
+    std::string message;
+    message.swap(pending_message);
+    error_pending = false;
+    throw gl::exception("gl error: %s", message);
+  }
+  if (error != GL_NO_ERROR) {
+    loge("gl error %s (%d) since the last check", error_name(error), error);
+    throw gl::exception("gl error %s (%d) since the last check", error_name(error), error);
+  }
+}
+
+
+#ifdef GL_VERSION_4_3
+
+void APIENTRY debug_callback(GLenum, GLenum type, GLuint id, GLenum severity,
+  GLsizei, const GLchar* message, const void*) {
+  if (type == GL_DEBUG_TYPE_ERROR) {
+    loge("gl debug %u: %s", id, message);
+    // Throwing through the driver isn't safe; the GL_CALL that caused this
+    // throws as soon as the call returns.
+    if (!error_pending) {
+      pending_message = message;
+      error_pending = true;
+    }
+  } else if (severity == GL_DEBUG_SEVERITY_HIGH || severity == GL_DEBUG_SEVERITY_MEDIUM) {
+    logw("gl debug %u: %s", id, message);
+  } else {
+    logv("gl debug %u: %s", id, message);
+  }
+}
+
+#endif
+
+}
+
+
+} // namespace gl
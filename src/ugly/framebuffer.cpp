@@ -2,11 +2,26 @@
 #include "texture.h"
 #include "renderbuffer.h"
 #include "vertex_array.h"
+#include "buffer.h"
 #include "program.h"
+#include "state_cache.h"
 
 namespace gl {
 
 
+namespace {
+
+inline void set_viewport(Viewport const& viewport) {
+  if (auto state = detail::current_state()) {
+    state->viewport(viewport);
+  } else {
+    GL_CALL(glViewport(viewport.x, viewport.y, viewport.width, viewport.height));
+  }
+}
+
+}
+
+
 
 #define FRAMEBUFFER_TEXTURE_IMPL(ND, ...) \
   FramebufferBindguard guard(GL_FRAMEBUFFER, *this); \
@@ -104,6 +119,16 @@ void BasicFramebuffer::draw(Program const& program, VertexArray const& vao) {
   }
 }
 
+void BasicFramebuffer::draw(Program const& program, VertexArray const& vao, GLenum mode, BufferSlice const& vertices, size_t stride) {
+  GL_ASSERT(stride && vertices.offset % stride == 0, "slice at %u isn't aligned to its stride %u", vertices.offset, stride);
+  draw(program, vao, mode, vertices.size / stride, vertices.offset / stride);
+}
+
+void BasicFramebuffer::draw_instanced(Program const& program, VertexArray const& vao, size_t instance_count, GLenum mode, BufferSlice const& vertices, size_t stride) {
+  GL_ASSERT(stride && vertices.offset % stride == 0, "slice at %u isn't aligned to its stride %u", vertices.offset, stride);
+  draw_instanced(program, vao, instance_count, mode, vertices.size / stride, vertices.offset / stride);
+}
+
 void Framebuffer::clear(GLenum mask) {
   FramebufferBindguard guard(GL_FRAMEBUFFER, *this);
   GL_CALL(glClearColor(_clear_color.r, _clear_color.g, _clear_color.b, _clear_color.a));
@@ -114,7 +139,7 @@ void Framebuffer::draw(Program const& program, VertexArray const& vao, GLenum mo
   VertexArrayBindguard guard(vao);
   ProgramBindguard program_guard(program);
   FramebufferBindguard fb_guard(GL_FRAMEBUFFER, *this);
-  GL_CALL(glViewport(_viewport.x, _viewport.y, _viewport.width, _viewport.height));
+  set_viewport(_viewport);
   GL_CALL(glDrawArrays(mode, (GLsizei)first, (GLsizei)count));
 }
 
@@ -122,7 +147,7 @@ void Framebuffer::draw_instanced(Program const& program, VertexArray const& vao,
   VertexArrayBindguard guard(vao);
   ProgramBindguard program_guard(program);
   FramebufferBindguard fb_guard(GL_FRAMEBUFFER, *this);
-  GL_CALL(glViewport(_viewport.x, _viewport.y, _viewport.width, _viewport.height));
+  set_viewport(_viewport);
   GL_CALL(glDrawArraysInstanced(mode, (GLsizei)first, (GLsizei)count, (GLsizei)instance_count));
 }
 
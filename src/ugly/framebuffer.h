@@ -13,6 +13,7 @@ class Texture3D;
 class Cubemap;
 class Renderbuffer;
 class VertexArray;
+struct BufferSlice;
 
 
 class BasicFramebuffer {
@@ -33,6 +34,14 @@ class BasicFramebuffer {
     virtual void draw(Program const&, VertexArray const&);
   
     virtual void draw_instanced(Program const&, VertexArray const&, size_t instance_count, GLenum mode, size_t count, size_t first = 0) =0;
+
+    /**
+     * @brief draw the vertices in `vertices`, `stride` bytes each. The
+     * VertexArray's attributes must point at the start of the slice's Buffer,
+     * so meshes sharing a Buffer (e.g. from a BufferHeap) share a VertexArray.
+     **/
+    void draw(Program const&, VertexArray const&, GLenum mode, BufferSlice const& vertices, size_t stride);
+    void draw_instanced(Program const&, VertexArray const&, size_t instance_count, GLenum mode, BufferSlice const& vertices, size_t stride);
   
   public:
     virtual void draw_buffer(GLenum buffer);
@@ -57,6 +66,8 @@ class Framebuffer
     void renderbuffer(GLenum attachment, Renderbuffer const& renderbuffer);
 
   public:
+    using BasicFramebuffer::draw;
+    using BasicFramebuffer::draw_instanced;
     void clear(GLenum mask) override;
     void draw(Program const& program, VertexArray const&, GLenum mode, size_t count, size_t first = 0) override;
     void draw_instanced(Program const&, VertexArray const&, size_t instance_count, GLenum mode, size_t count, size_t first = 0) override;
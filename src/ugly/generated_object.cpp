@@ -1,14 +1,56 @@
 #include "generated_object.h"
+#include "name_pool.h"
+#include "state_cache.h"
 
 namespace gl {
 
 typedef void(*glGenFunc)(GLsizei, GLuint*);
 typedef void(*glDeleteFunc)(GLsizei, GLuint const*);
 
+
+namespace {
+
+// Deleting an object implicitly unbinds it, so the state cache must stop
+// trusting any slot holding its name.
+template<glDeleteFunc DeleteFunc>
+inline void forget(StateCache&, GLuint) {}
+
+template<> inline void forget<glDeleteBuffers>(StateCache& state, GLuint name) { state.forget_buffer(name); }
+template<> inline void forget<glDeleteFramebuffers>(StateCache& state, GLuint name) { state.forget_framebuffer(name); }
+template<> inline void forget<glDeleteRenderbuffers>(StateCache& state, GLuint name) { state.forget_renderbuffer(name); }
+template<> inline void forget<glDeleteTextures>(StateCache& state, GLuint name) { state.forget_texture(name); }
+template<> inline void forget<glDeleteVertexArrays>(StateCache& state, GLuint name) { state.forget_vertex_array(name); }
+
+// Objects that hold other objects stay with the Context that made them.
+template<glDeleteFunc DeleteFunc>
+struct Shared { static const bool value = true; };
+
+template<> struct Shared<glDeleteFramebuffers> { static const bool value = false; };
+template<> struct Shared<glDeleteProgramPipelines> { static const bool value = false; };
+template<> struct Shared<glDeleteQueries> { static const bool value = false; };
+template<> struct Shared<glDeleteTransformFeedbacks> { static const bool value = false; };
+template<> struct Shared<glDeleteVertexArrays> { static const bool value = false; };
+
+template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
+struct Kind {
+  static const detail::NameKind value;
+};
+
+template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
+const detail::NameKind Kind<GenFunc, DeleteFunc>::value = { GenFunc, DeleteFunc, forget<DeleteFunc>, Shared<DeleteFunc>::value };
+
+}
+
+
 template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
 GeneratedObject<GenFunc, DeleteFunc>::GeneratedObject()
   : _owner(true) {
-  GL_CALL(GenFunc(1, &_name));
+  if (auto pool = detail::current_name_pool()) {
+    _name = pool->generate(Kind<GenFunc, DeleteFunc>::value);
+    _context = pool->deferred();
+  } else {
+    GL_CALL(GenFunc(1, &_name));
+  }
 }
 
 template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
@@ -20,8 +62,38 @@ GeneratedObject<GenFunc, DeleteFunc>::GeneratedObject(GLuint name)
 
 template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
 GeneratedObject<GenFunc, DeleteFunc>::~GeneratedObject() {
+  release();
+}
+
+template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
+GeneratedObject<GenFunc, DeleteFunc>::GeneratedObject(GeneratedObject&& other) noexcept
+  : _name(other._name)
+  , _owner(other._owner)
+  , _context(std::move(other._context))
+{
+  other._name = 0;
+  other._owner = false;
+}
+
+template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
+GeneratedObject<GenFunc, DeleteFunc>& GeneratedObject<GenFunc, DeleteFunc>::operator=(GeneratedObject&& other) noexcept {
+  if (this != &other) {
+    release();
+    _name = other._name;
+    _owner = other._owner;
+    _context = std::move(other._context);
+    other._name = 0;
+    other._owner = false;
+  }
+  return *this;
+}
+
+template<glGenFunc GenFunc, glDeleteFunc DeleteFunc>
+void GeneratedObject<GenFunc, DeleteFunc>::release() {
   if (_owner) {
-    GL_CALL_NOTHROW(DeleteFunc(1, &_name));
+    detail::release_name(_context, Kind<GenFunc, DeleteFunc>::value, _name);
+    _context.reset();
+    _owner = false;
   }
 }
 
@@ -3,8 +3,23 @@
 
 #include "gl_type.h"
 
+#include <memory>
+
 namespace gl {
 
+
+namespace detail {
+class DeletionQueue;
+}
+
+
+/**
+ * @brief an object named with glGenX and deleted with glDeleteX.
+ *
+ * The object belongs to the Context current when it was made, and may be
+ * destroyed on any thread: if that Context isn't current there, its name is
+ * handed to the Context to delete when it's next made current or ends a frame.
+ **/
 template<void(*glGenFunc)(GLsizei, GLuint*), void(*glDeleteFunc)(GLsizei, GLuint const*)>
 class GeneratedObject {
   protected:
@@ -16,12 +31,23 @@ class GeneratedObject {
     GeneratedObject& operator=(GeneratedObject const&) = delete;
     /* no virtual */ ~GeneratedObject();
 
+    /**
+     * @brief take over `other`'s name, and its ownership if it had any.
+     * `other` is left with the name 0, owning nothing.
+     **/
+    GeneratedObject(GeneratedObject&& other) noexcept;
+    GeneratedObject& operator=(GeneratedObject&& other) noexcept;
+
   public:
     inline GLuint name() const { return _name; }
 
+  private:
+    void release();
+
   private:
     GLuint _name;
     bool _owner { false };
+    std::shared_ptr<detail::DeletionQueue> _context;
 
 };
 
@@ -59,6 +59,11 @@ struct rect {
 using Viewport = rect<float>;
 
 
+template<typename T>
+bool operator==(rect<T> const& a, rect<T> const& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
 template<typename T>
 bool operator==(vec2<T> const& a, vec2<T> const& b) {
   return a.x == b.x && a.y == b.y;
@@ -102,26 +107,106 @@ struct range {
 };
 
 
+/**
+ * @brief a view of `count` contiguous T, e.g. a mapped Buffer. Doesn't own
+ * the memory.
+ **/
+template<typename T>
+struct span {
+  span(): _data(nullptr), _size(0) {}
+  span(T* data, size_t size): _data(data), _size(size) {}
+
+  T* data() const { return _data; }
+  size_t size() const { return _size; }
+  size_t size_bytes() const { return _size * sizeof(T); }
+  bool empty() const { return _size == 0; }
+
+  T& operator[](size_t i) const { return _data[i]; }
+  T* begin() const { return _data; }
+  T* end() const { return _data + _size; }
+
+  span subspan(size_t offset, size_t count) const { return span(_data + offset, count); }
+
+  private:
+    T* _data;
+    size_t _size;
+};
+
+
 using attribute = GLint;
 
 
+/**
+ * @brief how GL errors are caught. Set per Context with Context::error_policy().
+ *
+ *  - ERROR_POLICY_CHECKED: glGetError after every call, throwing gl::exception
+ *    on failure. Precise, but glGetError can stall the pipeline. (default)
+ *  - ERROR_POLICY_DEBUG_CALLBACK: a KHR_debug callback reports errors as they
+ *    happen; the failing GL_CALL throws. Needs GL 4.3 or KHR_debug.
+ *  - ERROR_POLICY_PER_FRAME: nothing per call; Context::end_frame() and
+ *    Context::check_errors() throw if anything went wrong since the last check.
+ *  - ERROR_POLICY_OFF: no checking at all.
+ *
+ * Building with UGLY_ERROR_CHECKS=0 (the default when NDEBUG is defined)
+ * compiles the per-call checks out entirely; CHECKED then behaves like
+ * PER_FRAME.
+ **/
+enum ErrorPolicy {
+  ERROR_POLICY_CHECKED = 0,
+  ERROR_POLICY_DEBUG_CALLBACK,
+  ERROR_POLICY_PER_FRAME,
+  ERROR_POLICY_OFF,
+};
+
+
+#ifndef UGLY_ERROR_CHECKS
+#ifdef NDEBUG
+#define UGLY_ERROR_CHECKS 0
+#else
+#define UGLY_ERROR_CHECKS 1
+#endif
+#endif
+
+
+namespace detail {
+
+// The policy of the Context current on this thread, and whether the debug
+// callback has seen an error that hasn't been thrown yet.
+extern thread_local ErrorPolicy error_policy;
+extern thread_local bool error_pending;
+
+void check_error(const char* call);
+void log_error(const char* call);
+void throw_pending_error(const char* call);
+
+}
+
+
+#if UGLY_ERROR_CHECKS
+
 #define GL_CALL(...) \
     __VA_ARGS__; {\
-    GLenum error = glGetError(); \
-    if (error != GL_NO_ERROR) { \
-      loge(#__VA_ARGS__ " failed: %d", error); \
-      throw gl::exception("gl call " #__VA_ARGS__ " failed: %d", error); \
+    if (gl::detail::error_policy == gl::ERROR_POLICY_CHECKED) { \
+      gl::detail::check_error(#__VA_ARGS__); \
+    } else if (gl::detail::error_pending) { \
+      gl::detail::throw_pending_error(#__VA_ARGS__); \
     } \
   }
 
 #define GL_CALL_NOTHROW(...) \
     __VA_ARGS__; {\
-    GLenum error = glGetError(); \
-    if (error != GL_NO_ERROR) { \
-      loge(#__VA_ARGS__ " failed: %d", error); \
+    if (gl::detail::error_policy == gl::ERROR_POLICY_CHECKED) { \
+      gl::detail::log_error(#__VA_ARGS__); \
     } \
   }
 
+#else
+
+#define GL_CALL(...) __VA_ARGS__;
+#define GL_CALL_NOTHROW(...) __VA_ARGS__;
+
+#endif
+
 #define GL_VALIDATE(Type, name) {\
   GL_CALL(bool valid = glIs##Type(name)) \
   if (!valid) { throw gl::exception("%u is not a " #Type "!", name); } \
@@ -140,16 +225,24 @@ using attribute = GLint;
 
 enum BufferIndex {
   BUFFER_INDEX_ARRAY = 0,
-  // BUFFER_INDEX_ATOMIC_COUNTER, // 4.2+
+#ifdef GL_VERSION_4_2
+  BUFFER_INDEX_ATOMIC_COUNTER,
+#endif
   BUFFER_INDEX_COPY_READ,
   BUFFER_INDEX_COPY_WRITE,
-  // BUFFER_INDEX_DISPATCH_INDIRECT, // 4.3+
+#ifdef GL_VERSION_4_3
+  BUFFER_INDEX_DISPATCH_INDIRECT,
+#endif
   BUFFER_INDEX_DRAW_INDIRECT,
   BUFFER_INDEX_ELEMENT_ARRAY,
   BUFFER_INDEX_PIXEL_PACK,
   BUFFER_INDEX_PIXEL_UNPACK,
-  // BUFFER_INDEX_QUERY, // 4.4+
-  // BUFFER_INDEX_SHADER_STORAGE, // 4.3+
+#ifdef GL_VERSION_4_4
+  BUFFER_INDEX_QUERY,
+#endif
+#ifdef GL_VERSION_4_3
+  BUFFER_INDEX_SHADER_STORAGE,
+#endif
   BUFFER_INDEX_TEXTURE,
   BUFFER_INDEX_TRANSFORM_FEEDBACK,
   BUFFER_INDEX_UNIFORM,
@@ -157,6 +250,55 @@ enum BufferIndex {
 };
 
 
+enum TextureIndex {
+  TEXTURE_INDEX_1D = 0,
+  TEXTURE_INDEX_1D_ARRAY,
+  TEXTURE_INDEX_2D,
+  TEXTURE_INDEX_2D_ARRAY,
+  TEXTURE_INDEX_2D_MULTISAMPLE,
+  TEXTURE_INDEX_2D_MULTISAMPLE_ARRAY,
+  TEXTURE_INDEX_3D,
+  TEXTURE_INDEX_BUFFER,
+  TEXTURE_INDEX_CUBE_MAP,
+  TEXTURE_INDEX_CUBE_MAP_ARRAY,
+  TEXTURE_INDEX_RECTANGLE,
+  TEXTURE_INDEX_MAX
+};
+
+
+// The capabilities Context::enable/disable are instantiated for.
+enum CapabilityIndex {
+  CAPABILITY_INDEX_BLEND = 0,
+  CAPABILITY_INDEX_COLOR_LOGIC_OP,
+  CAPABILITY_INDEX_CULL_FACE,
+  CAPABILITY_INDEX_DEPTH_CLAMP,
+  CAPABILITY_INDEX_DEPTH_TEST,
+  CAPABILITY_INDEX_DITHER,
+  CAPABILITY_INDEX_FRAMEBUFFER_SRGB,
+  CAPABILITY_INDEX_LINE_SMOOTH,
+  CAPABILITY_INDEX_MULTISAMPLE,
+  CAPABILITY_INDEX_POLYGON_OFFSET_FILL,
+  CAPABILITY_INDEX_POLYGON_OFFSET_LINE,
+  CAPABILITY_INDEX_POLYGON_OFFSET_POINT,
+  CAPABILITY_INDEX_POLYGON_SMOOTH,
+  CAPABILITY_INDEX_PRIMITIVE_RESTART,
+  CAPABILITY_INDEX_RASTERIZER_DISCARD,
+  CAPABILITY_INDEX_SAMPLE_ALPHA_TO_COVERAGE,
+  CAPABILITY_INDEX_SAMPLE_ALPHA_TO_ONE,
+  CAPABILITY_INDEX_SAMPLE_COVERAGE,
+  CAPABILITY_INDEX_SAMPLE_SHADING,
+  CAPABILITY_INDEX_SAMPLE_MASK,
+  CAPABILITY_INDEX_SCISSOR_TEST,
+  CAPABILITY_INDEX_STENCIL_TEST,
+  CAPABILITY_INDEX_TEXTURE_CUBE_MAP_SEAMLESS,
+  CAPABILITY_INDEX_PROGRAM_POINT_SIZE,
+  CAPABILITY_INDEX_MAX
+};
+
+
+
+
+class StateCache;
 
 template<typename T, void(*BindFunction)(GLenum, GLuint)>
 class Bindguard {
@@ -166,6 +308,9 @@ class Bindguard {
 
   private:
     GLenum _target;
+    StateCache* _state;
+    GLuint _previous;
+    GLuint _unit;  // active texture unit before a texture guard switched to 0
 
 };
 
@@ -175,6 +320,10 @@ class NoTargetBindguard {
   public:
     NoTargetBindguard(T const& object);
     ~NoTargetBindguard();
+
+  private:
+    StateCache* _state;
+    GLuint _previous;
 };
 
 class Buffer;
@@ -0,0 +1,189 @@
+#include "name_pool.h"
+#include "state_cache.h"
+
+namespace gl {
+namespace detail {
+
+
+DeletionQueue::~DeletionQueue() {
+  Node* node = take();
+  while (node) {
+    Node* next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+void DeletionQueue::push(NameKind const& kind, GLuint name) {
+  Node* node = new Node { &kind, name, _head.load(std::memory_order_relaxed) };
+  while (!_head.compare_exchange_weak(node->next, node, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+  }
+}
+
+
+NamePool::NamePool()
+  : _deferred(std::make_shared<DeletionQueue>())
+  {}
+
+
+NamePool::Names& NamePool::names(NameKind const& kind) {
+  for (auto& n : _names) {
+    if (n.kind == &kind) {
+      return n;
+    }
+  }
+  _names.push_back(Names { &kind, {}, {} });
+  return _names.back();
+}
+
+
+GLuint NamePool::generate(NameKind const& kind) {
+  auto& n = names(kind);
+  if (n.free.empty()) {
+    n.free.resize(block_size);
+    GL_CALL(kind.gen(block_size, n.free.data()));
+  }
+  GLuint name = n.free.back();
+  n.free.pop_back();
+  return name;
+}
+
+void NamePool::release(NameKind const& kind, GLuint name, StateCache& state) {
+  names(kind).released.push_back(name);
+  if (++_pending >= flush_threshold) {
+    flush(state);
+  }
+}
+
+
+void NamePool::take_deferred() {
+  auto node = _deferred->take();
+  while (node) {
+    auto next = node->next;
+    names(*node->kind).released.push_back(node->name);
+    ++_pending;
+    delete node;
+    node = next;
+  }
+}
+
+
+void NamePool::flush(StateCache& state) {
+  take_deferred();
+  if (!_pending) {
+    return;
+  }
+  for (auto& n : _names) {
+    if (n.released.empty()) {
+      continue;
+    }
+    // Deleting an object implicitly unbinds it.
+    for (GLuint name : n.released) {
+      n.kind->forget(state, name);
+    }
+    GL_CALL_NOTHROW(n.kind->del(GLsizei(n.released.size()), n.released.data()));
+    n.released.clear();
+  }
+  _pending = 0;
+}
+
+void NamePool::clear(StateCache& state) {
+  _deferred->close();
+  flush(state);
+  for (auto& n : _names) {
+    if (!n.free.empty()) {
+      GL_CALL_NOTHROW(n.kind->del(GLsizei(n.free.size()), n.free.data()));
+      n.free.clear();
+    }
+  }
+}
+
+
+
+size_t NamePool::abandon() {
+  _deferred->close();
+  take_deferred();
+  size_t count = 0;
+  for (auto& n : _names) {
+    count += n.free.size() + n.released.size();
+    n.free.clear();
+    n.released.clear();
+  }
+  _pending = 0;
+  return count;
+}
+
+
+
+std::shared_ptr<DeletionQueue> current_deletion_queue() {
+  auto pool = current_name_pool();
+  return pool ? pool->deferred() : nullptr;
+}
+
+namespace {
+
+void release_here(NameKind const& kind, GLuint name) {
+  if (auto pool = current_name_pool()) {
+    pool->release(kind, name, *current_state());
+  } else {
+    GL_CALL_NOTHROW(kind.del(1, &name));
+  }
+}
+
+// A closed owner's shared objects may still live on in Contexts sharing with
+// it; whatever is current here is the best remaining chance to delete them.
+// Its containers died with it, and their names may belong to something else
+// here.
+void release_orphan(NameKind const& kind, GLuint name) {
+  if (kind.shared) {
+    release_here(kind, name);
+  } else {
+    logw("dropping name %u: its Context is gone, and it can't be deleted from another", name);
+  }
+}
+
+void queue_release(std::shared_ptr<DeletionQueue> const& owner, NameKind const& kind, GLuint name) {
+  auto pool = current_name_pool();
+  if (!owner || (pool && pool->deferred() == owner)) {
+    release_here(kind, name);
+    return;
+  }
+  if (owner->closed()) {
+    release_orphan(kind, name);
+    return;
+  }
+
+  owner->push(kind, name);
+  if (owner->closed()) {
+    // Closed meanwhile, perhaps after the owner took its last names.
+    auto node = owner->take();
+    while (node) {
+      auto next = node->next;
+      release_orphan(*node->kind, node->name);
+      delete node;
+      node = next;
+    }
+  }
+}
+
+}
+
+void release_name(std::shared_ptr<DeletionQueue> const& owner, NameKind const& kind, GLuint name) noexcept {
+  try {
+    queue_release(owner, kind, name);
+  } catch (...) {
+    auto pool = current_name_pool();
+    if (!owner || (pool && pool->deferred() == owner)) {
+      if (pool) {
+        kind.forget(*current_state(), name);
+      }
+      GL_CALL_NOTHROW(kind.del(1, &name));
+    } else {
+      logw("couldn't queue name %u for deletion by its Context: it leaks", name);
+    }
+  }
+}
+
+
+} // namespace detail
+} // namespace gl
@@ -0,0 +1,172 @@
+#ifndef UGLY_NAME_POOL_H
+#define UGLY_NAME_POOL_H
+
+// Internal header: not installed, only included by the library's own sources.
+
+#include "gl_type.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+
+class StateCache;
+
+
+namespace detail {
+
+using GenFunc = void(*)(GLsizei, GLuint*);
+using DeleteFunc = void(*)(GLsizei, GLuint const*);
+
+/**
+ * @brief how to create and delete one kind of object, how to tell the
+ * StateCache it's gone, and whether Contexts sharing objects share it too.
+ * Containers (vertex arrays, framebuffers...) are never shared.
+ **/
+struct NameKind {
+  GenFunc gen;
+  DeleteFunc del;
+  void (*forget)(StateCache&, GLuint);
+  bool shared;
+};
+
+
+/**
+ * @brief names released on threads where their Context isn't current, waiting
+ * for it to take them. Any thread may push(); only the Context's own thread
+ * takes, so a push is one compare-and-swap and the owner never locks.
+ *
+ * Objects keep their Context's queue alive with a shared_ptr, so it may
+ * outlive the Context. Once the Context has closed it, pushing is pointless:
+ * the Context can't delete anything any more. A push can race with the
+ * close, so check closed() again after pushing, and take() back what's left
+ * if it's set.
+ **/
+class DeletionQueue {
+  public:
+    struct Node {
+      NameKind const* kind;
+      GLuint name;
+      Node* next;
+    };
+
+  public:
+    DeletionQueue() {}
+    ~DeletionQueue();
+    DeletionQueue(DeletionQueue const&) = delete;
+    DeletionQueue& operator=(DeletionQueue const&) = delete;
+
+  public:
+    void push(NameKind const&, GLuint name);
+
+    /**
+     * @brief everything pushed so far, newest first. The caller owns the nodes.
+     **/
+    Node* take() { return _head.exchange(nullptr); }
+
+    // Sequentially consistent, along with push() and take(): either a push
+    // sees the close, or the owner's take() after closing sees the push.
+    void close() { _closed.store(true); }
+    bool closed() const { return _closed.load(); }
+
+  private:
+    std::atomic<Node*> _head { nullptr };
+    std::atomic<bool> _closed { false };
+
+};
+
+
+/**
+ * @brief a Context's names: generated in blocks, and deleted in batches.
+ *
+ * Released names aren't deleted straight away, since the objects may still be
+ * bound; they're queued and deleted together by flush(), which Context calls
+ * at the end of each frame, when it clears its framebuffer and when it's made
+ * current, or once enough have piled up. Names released on other threads
+ * arrive through deferred(), and are collected at every flush.
+ **/
+class NamePool {
+  public:
+    static const GLsizei block_size = 64;
+    static const size_t flush_threshold = 1024;
+
+  public:
+    NamePool();
+    NamePool(NamePool const&) = delete;
+    NamePool& operator=(NamePool const&) = delete;
+
+  public:
+    GLuint generate(NameKind const&);
+    void release(NameKind const&, GLuint name, StateCache&);
+
+    /**
+     * @brief delete every released name, one call per kind.
+     **/
+    void flush(StateCache&);
+
+    /**
+     * @brief flush, and delete the names generated but never handed out.
+     * The Context must be current. Closes deferred().
+     **/
+    void clear(StateCache&);
+
+    /**
+     * @brief forget every name without deleting any, for a Context that
+     * can't be made current any more. Closes deferred(). Returns the number
+     * of names left behind.
+     **/
+    size_t abandon();
+
+    size_t pending() const { return _pending; }
+
+    std::shared_ptr<DeletionQueue> const& deferred() const { return _deferred; }
+
+  private:
+    struct Names {
+      NameKind const* kind;
+      std::vector<GLuint> free;
+      std::vector<GLuint> released;
+    };
+
+    Names& names(NameKind const&);
+    void take_deferred();
+
+  private:
+    std::vector<Names> _names;
+    size_t _pending { 0 };
+    std::shared_ptr<DeletionQueue> _deferred;
+
+};
+
+
+/**
+ * @brief the NamePool of the Context current on this thread, or nullptr if
+ * there isn't one (in which case names are generated and deleted one by one).
+ **/
+NamePool* current_name_pool();
+
+/**
+ * @brief the DeletionQueue of the Context current on this thread, to be kept
+ * by an object created there; null if there isn't one.
+ **/
+std::shared_ptr<DeletionQueue> current_deletion_queue();
+
+/**
+ * @brief dispose of a name belonging to the Context whose queue is `owner`:
+ * queue it locally if that Context is current here, hand it over through
+ * `owner` if not, and delete it at once if there's no Context to do either.
+ *
+ * Never throws, since noexcept moves and destructors call it. Queueing
+ * allocates; if that fails, the name is deleted at once where its Context is
+ * current, and leaked with a warning where it isn't.
+ **/
+void release_name(std::shared_ptr<DeletionQueue> const& owner, NameKind const&, GLuint name) noexcept;
+
+}
+
+
+} // namespace gl
+
+#endif
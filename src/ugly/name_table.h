@@ -0,0 +1,121 @@
+#ifndef UGLY_NAME_TABLE_H
+#define UGLY_NAME_TABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace gl {
+namespace detail {
+
+
+/**
+ * @brief a hash table from names to `T`, filled once and then only read,
+ * e.g. a Program's active uniforms. Entries sit in one vector in the order
+ * they were inserted; open addressing with linear probing over a power of
+ * two of slots, at most half full, finds them.
+ **/
+template<typename T>
+class NameTable {
+  public:
+    struct Entry {
+      uint32_t hash;
+      std::string name;
+      T value;
+    };
+
+  public:
+    void clear() {
+      _entries.clear();
+      _slots.clear();
+    }
+
+    /**
+     * @brief add `name`, or replace its value.
+     **/
+    void insert(std::string name, T const& value) {
+      uint32_t h = hash(name.data(), name.size());
+      if (uint32_t found = lookup(name.data(), name.size(), h)) {
+        _entries[found - 1].value = value;
+        return;
+      }
+      _entries.push_back(Entry { h, std::move(name), value });
+      if (_entries.size() * 2 > _slots.size()) {
+        rehash(_slots.empty() ? 16 : _slots.size() * 2);
+      } else {
+        place(uint32_t(_entries.size() - 1));
+      }
+    }
+
+    /**
+     * @brief the value for `name`, or nullptr if it wasn't inserted.
+     **/
+    T const* find(const char* name) const {
+      return find(name, std::strlen(name));
+    }
+
+    T const* find(std::string const& name) const {
+      return find(name.data(), name.size());
+    }
+
+    std::vector<Entry> const& entries() const { return _entries; }
+    size_t size() const { return _entries.size(); }
+
+  private:
+    // FNV-1a
+    static uint32_t hash(const char* name, size_t length) {
+      uint32_t h = 2166136261u;
+      for (size_t i = 0; i < length; ++i) {
+        h = (h ^ uint8_t(name[i])) * 16777619u;
+      }
+      return h;
+    }
+
+    T const* find(const char* name, size_t length) const {
+      uint32_t found = lookup(name, length, hash(name, length));
+      return found ? &_entries[found - 1].value : nullptr;
+    }
+
+    // The entry's index + 1, or 0.
+    uint32_t lookup(const char* name, size_t length, uint32_t h) const {
+      if (_slots.empty()) {
+        return 0;
+      }
+      size_t mask = _slots.size() - 1;
+      for (size_t s = h & mask; _slots[s]; s = (s + 1) & mask) {
+        auto const& entry = _entries[_slots[s] - 1];
+        if (entry.hash == h && entry.name.size() == length && std::memcmp(entry.name.data(), name, length) == 0) {
+          return _slots[s];
+        }
+      }
+      return 0;
+    }
+
+    void place(uint32_t index) {
+      size_t mask = _slots.size() - 1;
+      size_t s = _entries[index].hash & mask;
+      while (_slots[s]) {
+        s = (s + 1) & mask;
+      }
+      _slots[s] = index + 1;
+    }
+
+    void rehash(size_t slots) {
+      _slots.assign(slots, 0);
+      for (uint32_t i = 0; i < _entries.size(); ++i) {
+        place(i);
+      }
+    }
+
+  private:
+    std::vector<Entry> _entries;
+    std::vector<uint32_t> _slots;  // index into _entries + 1, 0 if empty
+
+};
+
+
+} // namespace detail
+} // namespace gl
+
+#endif
@@ -2,6 +2,11 @@
 #include "log.h"
 #include "context.h"
 #include "uniform.h"
+#include "state_cache.h"
+#include "name_pool.h"
+#include "context_impl.h"
+
+#include <algorithm>
 
 namespace gl {
 
@@ -13,14 +18,69 @@ static inline void print_log(GLuint id) {
 }
 
 
+namespace {
+
+void delete_programs(GLsizei n, GLuint const* names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    glDeleteProgram(names[i]);
+  }
+}
+
+void forget_program(StateCache& state, GLuint name) {
+  state.forget_program(name);
+}
+
+const detail::NameKind program_kind = { nullptr, delete_programs, forget_program, true };
+
+}
+
+
 Program::Program()
   : _name(0)
+  , _uniform_cache(new detail::UniformCache())
 {
   GL_CALL(_name = glCreateProgram());
+  _context = detail::current_deletion_queue();
 }
 
 Program::~Program() {
-  GL_CALL(glDeleteProgram(_name));
+  release();
+}
+
+Program::Program(Program&& other) noexcept
+  : _name(other._name)
+  , _context(std::move(other._context))
+  , _uniform_blocks(std::move(other._uniform_blocks))
+  , _storage_blocks(std::move(other._storage_blocks))
+  , _uniforms(std::move(other._uniforms))
+  , _attribs(std::move(other._attribs))
+  , _uniform_cache(std::move(other._uniform_cache))
+{
+  other._name = 0;
+}
+
+Program& Program::operator=(Program&& other) noexcept {
+  if (this != &other) {
+    release();
+    _name = other._name;
+    _context = std::move(other._context);
+    _uniform_blocks = std::move(other._uniform_blocks);
+    _storage_blocks = std::move(other._storage_blocks);
+    _uniforms = std::move(other._uniforms);
+    _attribs = std::move(other._attribs);
+    _uniform_cache = std::move(other._uniform_cache);
+    other._name = 0;
+  }
+  return *this;
+}
+
+void Program::release() {
+  if (!_name) {
+    return;
+  }
+  detail::release_name(_context, program_kind, _name);
+  _context.reset();
+  _name = 0;
 }
 
 
@@ -47,6 +107,35 @@ void Program::link() {
     print_log(name);
     throw gl::exception("failed to link program %u", name);
   }
+  on_link();
+}
+
+void Program::on_link() {
+  reflect_uniforms();
+  reflect_attribs();
+  reflect_uniform_blocks();
+  reflect_storage_blocks();
+
+  // Give each block its name's binding point in the current Context, once,
+  // rather than calling glUniformBlockBinding before every draw.
+  if (auto impl = Context_impl::current_on_thread()) {
+    for (auto& block : _uniform_blocks) {
+      GLuint binding = impl->_uniform_block_bindings.assign(block.name, block.binding, impl->_capabilities.max_uniform_buffer_bindings);
+      if (binding != block.binding) {
+        GL_CALL(glUniformBlockBinding(_name, block.index, binding));
+        block.binding = binding;
+      }
+    }
+#ifdef GL_VERSION_4_3
+    for (auto& block : _storage_blocks) {
+      GLuint binding = impl->_storage_block_bindings.assign(block.name, block.binding, impl->_capabilities.max_shader_storage_buffer_bindings);
+      if (binding != block.binding) {
+        GL_CALL(glShaderStorageBlockBinding(_name, block.index, binding));
+        block.binding = binding;
+      }
+    }
+#endif
+  }
 }
 
 GLuint Program::name() const {
@@ -54,23 +143,31 @@ GLuint Program::name() const {
 }
 
 GLint Program::uniform_location(const char* uniform_name) const {
-  GL_CALL(GLint location = glGetUniformLocation(name(), uniform_name));
-  return location;
+  auto info = _uniforms.find(uniform_name);
+  return info ? info->location : -1;
 }
 
 GLint Program::uniform_location(std::string const& uniform_name) const {
-  GL_CALL(GLint location = glGetUniformLocation(name(), uniform_name.c_str()));
-  return location;
+  auto info = _uniforms.find(uniform_name);
+  return info ? info->location : -1;
+}
+
+variable_info const* Program::uniform_variable(std::string const& uniform_name) const {
+  return _uniforms.find(uniform_name);
 }
 
 GLint Program::attrib_location(const char* attrib_name) const {
-  int location;
-  GL_CALL(location = glGetAttribLocation(_name, attrib_name));
-  return location;
+  auto info = _attribs.find(attrib_name);
+  return info ? info->location : -1;
 }
 
 GLint Program::attrib_location(std::string const& attrib_name) const {
-  return attrib_location(attrib_name.c_str());
+  auto info = _attribs.find(attrib_name);
+  return info ? info->location : -1;
+}
+
+variable_info const* Program::attrib_variable(std::string const& attrib_name) const {
+  return _attribs.find(attrib_name);
 }
 
 attrib Program::attrib(const char* name) const {
@@ -102,6 +199,10 @@ untyped_uniform Program::uniform(GLint location) const {
   return { *this, location };
 }
 
+void Program::invalidate_uniforms() {
+  _uniform_cache->invalidate();
+}
+
 
 GLint Program::get(GLenum param) const {
   GLint params[3];
@@ -118,6 +219,9 @@ Binary Program::binary() const {
 
 void Program::binary(Binary const& binary) {
   GL_CALL(glProgramBinary(name(), binary.format, binary.buffer.data(), (GLsizei)binary.buffer.size()));
+  if (get(GL_LINK_STATUS) == GL_TRUE) {
+    on_link();
+  }
 }
 
 GLint Program::stage(GLenum shadertype, GLenum param) const {
@@ -168,6 +272,69 @@ uniform_info Program::active_uniform(GLuint index) const {
 }
 
 
+void Program::reflect_uniforms() {
+  _uniforms.clear();
+  _uniform_cache->clear();
+  GLint count = get(GL_ACTIVE_UNIFORMS);
+  if (!count) {
+    return;
+  }
+  std::vector<char> name_buffer (get(GL_ACTIVE_UNIFORM_MAX_LENGTH) + 1);
+  GLsizei length;
+  GLint size;
+  GLenum type;
+
+  for (GLint i = 0; i < count; ++i) {
+    GL_CALL(glGetActiveUniform(_name, GLuint(i), GLsizei(name_buffer.size()), &length, &size, &type, name_buffer.data()));
+    std::string name (name_buffer.data(), length);
+    GL_CALL(GLint location = glGetUniformLocation(_name, name.c_str()));
+    if (location < 0) {
+      continue;  // a member of a uniform block, or an atomic counter
+    }
+    _uniforms.insert(name, variable_info { location, type, size });
+    _uniform_cache->add(location, type);
+
+    // An array is "name[0]": it can be looked up as "name" too, and each
+    // element as "name[i]". Elements aren't guaranteed consecutive locations.
+    auto bracket = name.rfind('[');
+    if (bracket != std::string::npos && name.compare(bracket, std::string::npos, "[0]") == 0) {
+      std::string base = name.substr(0, bracket);
+      _uniforms.insert(base, variable_info { location, type, size });
+      for (GLint e = 1; e < size; ++e) {
+        std::string element_name = base + "[" + std::to_string(e) + "]";
+        GL_CALL(GLint element = glGetUniformLocation(_name, element_name.c_str()));
+        _uniforms.insert(element_name, variable_info { element, type, size - e });
+        _uniform_cache->add(element, type, location);
+        location = element;
+      }
+    }
+  }
+}
+
+void Program::reflect_attribs() {
+  _attribs.clear();
+  GLint count = get(GL_ACTIVE_ATTRIBUTES);
+  if (!count) {
+    return;
+  }
+  std::vector<char> name_buffer (get(GL_ACTIVE_ATTRIBUTE_MAX_LENGTH) + 1);
+  GLsizei length;
+  GLint size;
+  GLenum type;
+
+  for (GLint i = 0; i < count; ++i) {
+    GL_CALL(glGetActiveAttrib(_name, GLuint(i), GLsizei(name_buffer.size()), &length, &size, &type, name_buffer.data()));
+    std::string name (name_buffer.data(), length);
+    GL_CALL(GLint location = glGetAttribLocation(_name, name.c_str()));
+    _attribs.insert(name, variable_info { location, type, size });
+    auto bracket = name.rfind('[');
+    if (bracket != std::string::npos && name.compare(bracket, std::string::npos, "[0]") == 0) {
+      _attribs.insert(name.substr(0, bracket), variable_info { location, type, size });
+    }
+  }
+}
+
+
 GLuint Program::uniform_block_index(const char* uniform_name) const {
   GL_CALL(return glGetUniformBlockIndex(name(), uniform_name));
 }
@@ -177,6 +344,185 @@ GLuint Program::uniform_block_index(std::string const& uniform_name) const {
 }
 
 
+void Program::reflect_uniform_blocks() {
+  _uniform_blocks.clear();
+  GLint count = get(GL_ACTIVE_UNIFORM_BLOCKS);
+  if (!count) {
+    return;
+  }
+  std::vector<char> name_buffer (std::max(get(GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH), get(GL_ACTIVE_UNIFORM_MAX_LENGTH)) + 1);
+  GLsizei length;
+
+  for (GLint i = 0; i < count; ++i) {
+    uniform_block_info block;
+    block.index = GLuint(i);
+    GL_CALL(glGetActiveUniformBlockName(_name, block.index, GLsizei(name_buffer.size()), &length, name_buffer.data()));
+    block.name.assign(name_buffer.data(), length);
+
+    GLint value;
+    GL_CALL(glGetActiveUniformBlockiv(_name, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size));
+    GL_CALL(glGetActiveUniformBlockiv(_name, block.index, GL_UNIFORM_BLOCK_BINDING, &value));
+    block.binding = GLuint(value);
+    GL_CALL(glGetActiveUniformBlockiv(_name, block.index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &value));
+
+    std::vector<GLint> indices (value);
+    if (value) {
+      GL_CALL(glGetActiveUniformBlockiv(_name, block.index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data()));
+    }
+    std::vector<GLuint> members (indices.begin(), indices.end());
+    auto query = [&](GLenum param) {
+      std::vector<GLint> values (members.size());
+      GL_CALL(glGetActiveUniformsiv(_name, GLsizei(members.size()), members.data(), param, values.data()));
+      return values;
+    };
+    auto types = query(GL_UNIFORM_TYPE);
+    auto sizes = query(GL_UNIFORM_SIZE);
+    auto offsets = query(GL_UNIFORM_OFFSET);
+    auto array_strides = query(GL_UNIFORM_ARRAY_STRIDE);
+    auto matrix_strides = query(GL_UNIFORM_MATRIX_STRIDE);
+    auto row_major = query(GL_UNIFORM_IS_ROW_MAJOR);
+
+    for (size_t m = 0; m < members.size(); ++m) {
+      GL_CALL(glGetActiveUniformName(_name, members[m], GLsizei(name_buffer.size()), &length, name_buffer.data()));
+      block.members.push_back(block_member_info {
+        std::string(name_buffer.data(), length), GLenum(types[m]), sizes[m], offsets[m],
+        array_strides[m], matrix_strides[m], row_major[m] != 0
+      });
+    }
+    std::sort(block.members.begin(), block.members.end(), [](block_member_info const& a, block_member_info const& b) {
+      return a.offset < b.offset;
+    });
+    _uniform_blocks.push_back(std::move(block));
+  }
+}
+
+void Program::reflect_storage_blocks() {
+  _storage_blocks.clear();
+#ifdef GL_VERSION_4_3
+  auto caps = detail::current_capabilities();
+  if (caps && !caps->version_at_least(4, 3)) {
+    return;
+  }
+  GLint count, max_name, max_member_name;
+  GL_CALL(glGetProgramInterfaceiv(_name, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count));
+  if (!count) {
+    return;
+  }
+  GL_CALL(glGetProgramInterfaceiv(_name, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &max_name));
+  GL_CALL(glGetProgramInterfaceiv(_name, GL_BUFFER_VARIABLE, GL_MAX_NAME_LENGTH, &max_member_name));
+  std::vector<char> name_buffer (std::max(max_name, max_member_name) + 1);
+  GLsizei length;
+
+  for (GLint i = 0; i < count; ++i) {
+    storage_block_info block;
+    block.index = GLuint(i);
+    GL_CALL(glGetProgramResourceName(_name, GL_SHADER_STORAGE_BLOCK, block.index, GLsizei(name_buffer.size()), &length, name_buffer.data()));
+    block.name.assign(name_buffer.data(), length);
+
+    const GLenum block_props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+    GLint values[3];
+    GL_CALL(glGetProgramResourceiv(_name, GL_SHADER_STORAGE_BLOCK, block.index, 3, block_props, 3, nullptr, values));
+    block.binding = GLuint(values[0]);
+    block.size = values[1];
+
+    std::vector<GLint> members (values[2]);
+    if (!members.empty()) {
+      const GLenum active = GL_ACTIVE_VARIABLES;
+      GL_CALL(glGetProgramResourceiv(_name, GL_SHADER_STORAGE_BLOCK, block.index, 1, &active, GLsizei(members.size()), nullptr, members.data()));
+    }
+    for (GLint member : members) {
+      const GLenum props[] = { GL_TYPE, GL_ARRAY_SIZE, GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE, GL_IS_ROW_MAJOR };
+      GLint v[6];
+      GL_CALL(glGetProgramResourceiv(_name, GL_BUFFER_VARIABLE, GLuint(member), 6, props, 6, nullptr, v));
+      GL_CALL(glGetProgramResourceName(_name, GL_BUFFER_VARIABLE, GLuint(member), GLsizei(name_buffer.size()), &length, name_buffer.data()));
+      block.members.push_back(block_member_info {
+        std::string(name_buffer.data(), length), GLenum(v[0]), v[1], v[2], v[3], v[4], v[5] != 0
+      });
+    }
+    std::sort(block.members.begin(), block.members.end(), [](block_member_info const& a, block_member_info const& b) {
+      return a.offset < b.offset;
+    });
+    _storage_blocks.push_back(std::move(block));
+  }
+#endif
+}
+
+uniform_block_info const* Program::uniform_block(std::string const& name) const {
+  for (auto const& block : _uniform_blocks) {
+    if (block.name == name) {
+      return &block;
+    }
+  }
+  return nullptr;
+}
+
+void Program::uniform_block_binding(std::string const& name, GLuint binding) {
+  for (auto& block : _uniform_blocks) {
+    if (block.name == name) {
+      GL_CALL(glUniformBlockBinding(_name, block.index, binding));
+      block.binding = binding;
+      return;
+    }
+  }
+  throw gl::exception("program %u has no active uniform block %s", _name, name.c_str());
+}
+
+
+storage_block_info const* Program::storage_block(std::string const& name) const {
+  for (auto const& block : _storage_blocks) {
+    if (block.name == name) {
+      return &block;
+    }
+  }
+  return nullptr;
+}
+
+void Program::storage_block_binding(std::string const& name, GLuint binding) {
+#ifdef GL_VERSION_4_3
+  for (auto& block : _storage_blocks) {
+    if (block.name == name) {
+      GL_CALL(glShaderStorageBlockBinding(_name, block.index, binding));
+      block.binding = binding;
+      return;
+    }
+  }
+#endif
+  throw gl::exception("program %u has no active storage block %s", _name, name.c_str());
+}
+
+
+void Program::verify_uniform_block(std::string const& name, std::vector<size_t> const& offsets) const {
+  verify_block(uniform_block(name), name, offsets, {}, {});
+}
+
+void Program::verify_storage_block(std::string const& name, std::vector<size_t> const& offsets) const {
+  verify_block(storage_block(name), name, offsets, {}, {});
+}
+
+void Program::verify_block(block_info const* block, std::string const& name, std::vector<size_t> const& offsets,
+  std::vector<size_t> const& array_strides, std::vector<size_t> const& matrix_strides) const
+{
+  if (!block) {
+    throw gl::exception("program %u has no active block %s", _name, name.c_str());
+  }
+  if (block->members.size() != offsets.size()) {
+    throw gl::exception("block %s has %u members, not %u", name.c_str(), block->members.size(), offsets.size());
+  }
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    auto const& member = block->members[i];
+    if (size_t(member.offset) != offsets[i]) {
+      throw gl::exception("block %s: %s is at %u, not %u", name.c_str(), member.name.c_str(), member.offset, offsets[i]);
+    }
+    if (!array_strides.empty() && size_t(member.array_stride) != array_strides[i]) {
+      throw gl::exception("block %s: %s has an array stride of %u, not %u", name.c_str(), member.name.c_str(), member.array_stride, array_strides[i]);
+    }
+    if (!matrix_strides.empty() && size_t(member.matrix_stride) != matrix_strides[i]) {
+      throw gl::exception("block %s: %s has a matrix stride of %u, not %u", name.c_str(), member.name.c_str(), member.matrix_stride, matrix_strides[i]);
+    }
+  }
+}
+
+
 
 } // namespace gl
 
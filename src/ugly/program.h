@@ -8,6 +8,11 @@
 #include "gl_type.h"
 #include "shader.h"
 #include "context.h"
+#include "block_layout.h"
+#include "uniform_cache.h"
+#include "name_table.h"
+
+#include <utility>
 
 
 namespace gl {
@@ -15,6 +20,10 @@ namespace gl {
 class untyped_uniform;
 class attrib;
 
+namespace detail {
+class basic_uniform;
+}
+
 struct uniform_info {
   GLuint index;
   GLenum type;
@@ -22,6 +31,35 @@ struct uniform_info {
   std::string name;
 };
 
+// An active uniform outside any block, or an active attribute.
+struct variable_info {
+  GLint location;
+  GLenum type;  // e.g. GL_FLOAT_VEC4
+  GLint size;   // elements, for arrays: from this one to the end
+};
+
+struct block_member_info {
+  std::string name;
+  GLenum type;
+  GLint size;          // elements, for arrays
+  GLint offset;        // bytes from the start of the block
+  GLint array_stride;  // 0 unless an array
+  GLint matrix_stride; // 0 unless a matrix
+  bool row_major;
+};
+
+// A uniform block, or a shader storage block.
+struct block_info {
+  GLuint index;
+  std::string name;
+  GLint size;       // GL_UNIFORM_BLOCK_DATA_SIZE or GL_BUFFER_DATA_SIZE
+  GLuint binding;
+  std::vector<block_member_info> members;  // by offset
+};
+
+using uniform_block_info = block_info;
+using storage_block_info = block_info;
+
 struct Binary {
   std::vector<uint8_t> buffer;
   GLenum format;
@@ -40,6 +78,8 @@ class Program {
   public:
     Program(Program const&) = delete;
     Program& operator=(Program const&) = delete;
+    Program(Program&&) noexcept;
+    Program& operator=(Program&&) noexcept;
     ~Program();
 
   public:
@@ -55,10 +95,22 @@ class Program {
     GLuint name() const;
 
   public: // uniforms
+    /**
+     * @brief the location of uniform `name`, or -1 if it isn't active. Active
+     * uniforms and attributes are reflected when the Program is linked, so
+     * lookups don't call into GL. An array can be looked up as "name",
+     * "name[0]", or "name[i]" for each element.
+     **/
     GLint uniform_location(const char* name) const;
     GLint uniform_location(std::string const& name) const;
     uniform_info active_uniform(GLuint index) const;
 
+    /**
+     * @brief the location, type and size of uniform `name`, or nullptr if
+     * it isn't active. Members of uniform blocks are in uniform_blocks().
+     **/
+    variable_info const* uniform_variable(std::string const& name) const;
+
   public:
     untyped_uniform operator[](const char* name) const;
     untyped_uniform operator[](std::string const& name) const;
@@ -66,13 +118,75 @@ class Program {
     untyped_uniform uniform(std::string const& name) const;
     untyped_uniform uniform(GLint location) const;
 
+    /**
+     * @brief counts of uniform sets issued to GL vs. skipped because the
+     * location already held the same value. The Program keeps the last value
+     * set through a uniform at each location since it was linked; anything
+     * set with glProgramUniform/glUniform directly needs
+     * invalidate_uniforms() afterwards.
+     **/
+    UniformStats const& uniform_stats() const { return _uniform_cache->stats(); }
+    void reset_uniform_stats() { _uniform_cache->reset_stats(); }
+    void invalidate_uniforms();
+
   public: // uniform block, uniform buffer
     GLuint uniform_block_index(const char* name) const;
     GLuint uniform_block_index(std::string const& name) const;
 
+    /**
+     * @brief the active uniform blocks, reflected when the Program was linked.
+     **/
+    std::vector<uniform_block_info> const& uniform_blocks() const { return _uniform_blocks; }
+
+    /**
+     * @brief the block called `name`, or nullptr if there's no such active block.
+     **/
+    uniform_block_info const* uniform_block(std::string const& name) const;
+
+    /**
+     * @brief bind block `name` to `binding` with glUniformBlockBinding. Blocks
+     * are bound when the Program is linked (see Context::uniform_block_binding),
+     * so this is only needed to override that.
+     **/
+    void uniform_block_binding(std::string const& name, GLuint binding);
+
+    /**
+     * @brief throw gl::exception unless block `name` has one member at each
+     * of `offsets`, in bytes, e.g. offsetof() each member of the C++ struct
+     * that's uploaded to it. Call it at startup, not per frame.
+     **/
+    void verify_uniform_block(std::string const& name, std::vector<size_t> const& offsets) const;
+
+    /**
+     * @brief throw gl::exception unless block `name` is laid out as `Layout`,
+     * a BlockLayout: its members' offsets, array strides and matrix strides.
+     **/
+    template<typename Layout>
+    void verify_uniform_block(std::string const& name) const {
+      verify_block<Layout>(uniform_block(name), name, std::make_index_sequence<Layout::count>());
+    }
+
+  public: // shader storage blocks, GL 4.3
+    /**
+     * @brief the active shader storage blocks, reflected at link, and bound
+     * like uniform blocks (see Context::storage_block_binding). Empty before
+     * GL 4.3. A block's last member may be an unsized array, of size 0.
+     **/
+    std::vector<storage_block_info> const& storage_blocks() const { return _storage_blocks; }
+    storage_block_info const* storage_block(std::string const& name) const;
+    void storage_block_binding(std::string const& name, GLuint binding);
+
+    void verify_storage_block(std::string const& name, std::vector<size_t> const& offsets) const;
+
+    template<typename Layout>
+    void verify_storage_block(std::string const& name) const {
+      verify_block<Layout>(storage_block(name), name, std::make_index_sequence<Layout::count>());
+    }
+
   public:
     GLint attrib_location(const char* name) const;
     GLint attrib_location(std::string const& name) const;
+    variable_info const* attrib_variable(std::string const& name) const;
     class attrib attrib(const char* name) const;
     class attrib attrib(std::string const& name) const;
 
@@ -97,9 +211,37 @@ class Program {
   
   private:
     void attach() {}
+    void release();
+    void on_link();
+    void reflect_uniforms();
+    void reflect_attribs();
+    void reflect_uniform_blocks();
+    void reflect_storage_blocks();
+
+    template<typename Layout, size_t... I>
+    void verify_block(block_info const* block, std::string const& name, std::index_sequence<I...>) const {
+      verify_block(block, name,
+        { Layout::offset(I)... },
+        { (Layout::template field<I>::is_array ? Layout::template field<I>::stride : 0)... },
+        { (Layout::template field<I>::type::columns > 1 ? Layout::template field<I>::column_stride : 0)... }
+      );
+    }
+
+    void verify_block(block_info const* block, std::string const& name, std::vector<size_t> const& offsets,
+      std::vector<size_t> const& array_strides, std::vector<size_t> const& matrix_strides) const;
 
   private:
     GLuint _name;
+    std::shared_ptr<detail::DeletionQueue> _context;  // see GeneratedObject
+    std::vector<uniform_block_info> _uniform_blocks;
+    std::vector<storage_block_info> _storage_blocks;
+    detail::NameTable<variable_info> _uniforms;
+    detail::NameTable<variable_info> _attribs;
+    // On the heap, so it stays put when the Program is moved; see CommandBuffer.
+    std::unique_ptr<detail::UniformCache> _uniform_cache;
+
+    friend class detail::basic_uniform;
+    friend class CommandBuffer;
 
 };
 
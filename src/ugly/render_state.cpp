@@ -0,0 +1,469 @@
+#include "render_state.h"
+#include "enum.h"
+
+namespace gl {
+
+
+static_assert(CAPABILITY_INDEX_MAX < 32, "capability bits must fit in RenderState::_enabled");
+
+
+namespace {
+
+const GLenum capabilities[CAPABILITY_INDEX_MAX] = {
+  GL_BLEND,
+  GL_COLOR_LOGIC_OP,
+  GL_CULL_FACE,
+  GL_DEPTH_CLAMP,
+  GL_DEPTH_TEST,
+  GL_DITHER,
+  GL_FRAMEBUFFER_SRGB,
+  GL_LINE_SMOOTH,
+  GL_MULTISAMPLE,
+  GL_POLYGON_OFFSET_FILL,
+  GL_POLYGON_OFFSET_LINE,
+  GL_POLYGON_OFFSET_POINT,
+  GL_POLYGON_SMOOTH,
+  GL_PRIMITIVE_RESTART,
+  GL_RASTERIZER_DISCARD,
+  GL_SAMPLE_ALPHA_TO_COVERAGE,
+  GL_SAMPLE_ALPHA_TO_ONE,
+  GL_SAMPLE_COVERAGE,
+  GL_SAMPLE_SHADING,
+  GL_SAMPLE_MASK,
+  GL_SCISSOR_TEST,
+  GL_STENCIL_TEST,
+  GL_TEXTURE_CUBE_MAP_SEAMLESS,
+  GL_PROGRAM_POINT_SIZE,
+};
+
+inline uint32_t bit(CapabilityIndex index) {
+  return 1u << index;
+}
+
+CapabilityIndex checked_index(GLenum capability) {
+  auto index = capability_index(capability);
+  if (index == CAPABILITY_INDEX_MAX) {
+    throw gl::exception("%s (%u) is not a capability RenderState tracks", to_string(capability), capability);
+  }
+  return index;
+}
+
+inline void set_capability(CapabilityIndex index, bool enabled) {
+  if (enabled) {
+    GL_CALL(glEnable(capabilities[index]));
+  } else {
+    GL_CALL(glDisable(capabilities[index]));
+  }
+}
+
+// The small enums live in RenderState::_packed as indices into these tables,
+// one bit field each, so a whole group compares with a single mask.
+const GLenum blend_factors[] = {
+  GL_ZERO,
+  GL_ONE,
+  GL_SRC_COLOR,
+  GL_ONE_MINUS_SRC_COLOR,
+  GL_DST_COLOR,
+  GL_ONE_MINUS_DST_COLOR,
+  GL_SRC_ALPHA,
+  GL_ONE_MINUS_SRC_ALPHA,
+  GL_DST_ALPHA,
+  GL_ONE_MINUS_DST_ALPHA,
+  GL_CONSTANT_COLOR,
+  GL_ONE_MINUS_CONSTANT_COLOR,
+  GL_CONSTANT_ALPHA,
+  GL_ONE_MINUS_CONSTANT_ALPHA,
+  GL_SRC_ALPHA_SATURATE,
+  GL_SRC1_COLOR,
+  GL_ONE_MINUS_SRC1_COLOR,
+  GL_SRC1_ALPHA,
+  GL_ONE_MINUS_SRC1_ALPHA,
+};
+
+const GLenum blend_equations[] = {
+  GL_FUNC_ADD,
+  GL_FUNC_SUBTRACT,
+  GL_FUNC_REVERSE_SUBTRACT,
+  GL_MIN,
+  GL_MAX,
+};
+
+const GLenum compare_funcs[] = {
+  GL_NEVER,
+  GL_LESS,
+  GL_EQUAL,
+  GL_LEQUAL,
+  GL_GREATER,
+  GL_NOTEQUAL,
+  GL_GEQUAL,
+  GL_ALWAYS,
+};
+
+const GLenum faces[] = {
+  GL_FRONT,
+  GL_BACK,
+  GL_FRONT_AND_BACK,
+};
+
+const GLenum windings[] = {
+  GL_CW,
+  GL_CCW,
+};
+
+const GLenum stencil_ops[] = {
+  GL_KEEP,
+  GL_ZERO,
+  GL_REPLACE,
+  GL_INCR,
+  GL_INCR_WRAP,
+  GL_DECR,
+  GL_DECR_WRAP,
+  GL_INVERT,
+};
+
+struct Field {
+  unsigned shift;
+  unsigned width;
+
+  uint64_t mask() const { return ((uint64_t(1) << width) - 1) << shift; }
+};
+
+const Field BLEND_SRC_RGB { 0, 5 };
+const Field BLEND_DST_RGB { 5, 5 };
+const Field BLEND_SRC_ALPHA { 10, 5 };
+const Field BLEND_DST_ALPHA { 15, 5 };
+const Field BLEND_EQUATION_RGB { 20, 3 };
+const Field BLEND_EQUATION_ALPHA { 23, 3 };
+const Field DEPTH_FUNC { 26, 3 };
+const Field DEPTH_MASK { 29, 1 };
+const Field CULL_FACE { 30, 2 };
+const Field FRONT_FACE { 32, 1 };
+const Field COLOR_MASK { 33, 4 }; // r, g, b, a
+const Field STENCIL_FUNC { 37, 3 };
+const Field STENCIL_FAIL { 40, 3 };
+const Field STENCIL_DEPTH_FAIL { 43, 3 };
+const Field STENCIL_DEPTH_PASS { 46, 3 };
+
+// The fields each GL call covers.
+const uint64_t BLEND_FUNC_FIELDS = BLEND_SRC_RGB.mask() | BLEND_DST_RGB.mask() | BLEND_SRC_ALPHA.mask() | BLEND_DST_ALPHA.mask();
+const uint64_t BLEND_EQUATION_FIELDS = BLEND_EQUATION_RGB.mask() | BLEND_EQUATION_ALPHA.mask();
+const uint64_t STENCIL_OP_FIELDS = STENCIL_FAIL.mask() | STENCIL_DEPTH_FAIL.mask() | STENCIL_DEPTH_PASS.mask();
+
+static_assert(sizeof(blend_factors) / sizeof(GLenum) <= 32, "blend factors must fit in 5 bits");
+
+inline unsigned get(uint64_t packed, Field field) {
+  return unsigned((packed & field.mask()) >> field.shift);
+}
+
+inline void set(uint64_t& packed, Field field, unsigned value) {
+  packed = (packed & ~field.mask()) | (uint64_t(value) << field.shift);
+}
+
+template<size_t N>
+unsigned code(GLenum const (&table)[N], GLenum value, const char* what) {
+  for (unsigned i = 0; i < N; ++i) {
+    if (table[i] == value) {
+      return i;
+    }
+  }
+  throw gl::exception("%s (%u) is not a %s", to_string(value), value, what);
+}
+
+inline GLenum blend_factor_of(uint64_t packed, Field field) {
+  return blend_factors[get(packed, field)];
+}
+
+inline GLenum blend_equation_of(uint64_t packed, Field field) {
+  return blend_equations[get(packed, field)];
+}
+
+inline GLenum compare_func_of(uint64_t packed, Field field) {
+  return compare_funcs[get(packed, field)];
+}
+
+inline GLenum stencil_op_of(uint64_t packed, Field field) {
+  return stencil_ops[get(packed, field)];
+}
+
+inline void hash_combine(size_t& seed, size_t value) {
+  seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+}
+
+
+CapabilityIndex capability_index(GLenum capability) {
+  switch (capability) {
+    case GL_BLEND: return CAPABILITY_INDEX_BLEND;
+    case GL_COLOR_LOGIC_OP: return CAPABILITY_INDEX_COLOR_LOGIC_OP;
+    case GL_CULL_FACE: return CAPABILITY_INDEX_CULL_FACE;
+    case GL_DEPTH_CLAMP: return CAPABILITY_INDEX_DEPTH_CLAMP;
+    case GL_DEPTH_TEST: return CAPABILITY_INDEX_DEPTH_TEST;
+    case GL_DITHER: return CAPABILITY_INDEX_DITHER;
+    case GL_FRAMEBUFFER_SRGB: return CAPABILITY_INDEX_FRAMEBUFFER_SRGB;
+    case GL_LINE_SMOOTH: return CAPABILITY_INDEX_LINE_SMOOTH;
+    case GL_MULTISAMPLE: return CAPABILITY_INDEX_MULTISAMPLE;
+    case GL_POLYGON_OFFSET_FILL: return CAPABILITY_INDEX_POLYGON_OFFSET_FILL;
+    case GL_POLYGON_OFFSET_LINE: return CAPABILITY_INDEX_POLYGON_OFFSET_LINE;
+    case GL_POLYGON_OFFSET_POINT: return CAPABILITY_INDEX_POLYGON_OFFSET_POINT;
+    case GL_POLYGON_SMOOTH: return CAPABILITY_INDEX_POLYGON_SMOOTH;
+    case GL_PRIMITIVE_RESTART: return CAPABILITY_INDEX_PRIMITIVE_RESTART;
+    case GL_RASTERIZER_DISCARD: return CAPABILITY_INDEX_RASTERIZER_DISCARD;
+    case GL_SAMPLE_ALPHA_TO_COVERAGE: return CAPABILITY_INDEX_SAMPLE_ALPHA_TO_COVERAGE;
+    case GL_SAMPLE_ALPHA_TO_ONE: return CAPABILITY_INDEX_SAMPLE_ALPHA_TO_ONE;
+    case GL_SAMPLE_COVERAGE: return CAPABILITY_INDEX_SAMPLE_COVERAGE;
+    case GL_SAMPLE_SHADING: return CAPABILITY_INDEX_SAMPLE_SHADING;
+    case GL_SAMPLE_MASK: return CAPABILITY_INDEX_SAMPLE_MASK;
+    case GL_SCISSOR_TEST: return CAPABILITY_INDEX_SCISSOR_TEST;
+    case GL_STENCIL_TEST: return CAPABILITY_INDEX_STENCIL_TEST;
+    case GL_TEXTURE_CUBE_MAP_SEAMLESS: return CAPABILITY_INDEX_TEXTURE_CUBE_MAP_SEAMLESS;
+    case GL_PROGRAM_POINT_SIZE: return CAPABILITY_INDEX_PROGRAM_POINT_SIZE;
+    default: return CAPABILITY_INDEX_MAX;
+  }
+}
+
+GLenum capability(CapabilityIndex index) {
+  GL_BOUNDS_CHECK(index, CAPABILITY_INDEX_MAX);
+  return capabilities[index];
+}
+
+
+// GL defaults: everything off except dithering and multisampling.
+RenderState::RenderState()
+  : _enabled(bit(CAPABILITY_INDEX_DITHER) | bit(CAPABILITY_INDEX_MULTISAMPLE))
+  , _packed(0)
+  , _polygon_offset_factor(0)
+  , _polygon_offset_units(0)
+  , _stencil_ref(0)
+  , _stencil_value_mask(~0u)
+  , _stencil_write_mask(~0u) {
+  *this = blend_func(GL_ONE, GL_ZERO)
+    .blend_equation(GL_FUNC_ADD)
+    .depth_func(GL_LESS)
+    .depth_mask(true)
+    .cull_face(GL_BACK)
+    .front_face(GL_CCW)
+    .color_mask(true, true, true, true)
+    .stencil_func(GL_ALWAYS, 0, ~0u)
+    .stencil_op(GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+
+void RenderState::set_enabled(CapabilityIndex index, bool enabled) {
+  if (enabled) {
+    _enabled |= bit(index);
+  } else {
+    _enabled &= ~bit(index);
+  }
+}
+
+RenderState RenderState::enable(GLenum capability) const {
+  auto rv = *this;
+  rv.set_enabled(checked_index(capability), true);
+  return rv;
+}
+
+RenderState RenderState::disable(GLenum capability) const {
+  auto rv = *this;
+  rv.set_enabled(checked_index(capability), false);
+  return rv;
+}
+
+bool RenderState::is_enabled(GLenum capability) const {
+  return _enabled & bit(checked_index(capability));
+}
+
+
+RenderState RenderState::blend_func(GLenum src, GLenum dst) const {
+  return blend_func(src, dst, src, dst);
+}
+
+RenderState RenderState::blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) const {
+  auto rv = *this;
+  set(rv._packed, BLEND_SRC_RGB, code(blend_factors, src_rgb, "blend factor"));
+  set(rv._packed, BLEND_DST_RGB, code(blend_factors, dst_rgb, "blend factor"));
+  set(rv._packed, BLEND_SRC_ALPHA, code(blend_factors, src_alpha, "blend factor"));
+  set(rv._packed, BLEND_DST_ALPHA, code(blend_factors, dst_alpha, "blend factor"));
+  return rv;
+}
+
+RenderState RenderState::blend_equation(GLenum mode) const {
+  return blend_equation(mode, mode);
+}
+
+RenderState RenderState::blend_equation(GLenum mode_rgb, GLenum mode_alpha) const {
+  auto rv = *this;
+  set(rv._packed, BLEND_EQUATION_RGB, code(blend_equations, mode_rgb, "blend equation"));
+  set(rv._packed, BLEND_EQUATION_ALPHA, code(blend_equations, mode_alpha, "blend equation"));
+  return rv;
+}
+
+RenderState RenderState::depth_func(GLenum func) const {
+  auto rv = *this;
+  set(rv._packed, DEPTH_FUNC, code(compare_funcs, func, "depth function"));
+  return rv;
+}
+
+RenderState RenderState::depth_mask(bool write) const {
+  auto rv = *this;
+  set(rv._packed, DEPTH_MASK, write);
+  return rv;
+}
+
+RenderState RenderState::cull_face(GLenum mode) const {
+  auto rv = *this;
+  set(rv._packed, CULL_FACE, code(faces, mode, "cull face mode"));
+  return rv;
+}
+
+RenderState RenderState::front_face(GLenum mode) const {
+  auto rv = *this;
+  set(rv._packed, FRONT_FACE, code(windings, mode, "front face winding"));
+  return rv;
+}
+
+RenderState RenderState::polygon_offset(float factor, float units) const {
+  auto rv = *this;
+  rv._polygon_offset_factor = factor;
+  rv._polygon_offset_units = units;
+  return rv;
+}
+
+RenderState RenderState::color_mask(bool r, bool g, bool b, bool a) const {
+  auto rv = *this;
+  set(rv._packed, COLOR_MASK, (r ? 1u : 0u) | (g ? 2u : 0u) | (b ? 4u : 0u) | (a ? 8u : 0u));
+  return rv;
+}
+
+RenderState RenderState::stencil_func(GLenum func, GLint ref, GLuint mask) const {
+  auto rv = *this;
+  set(rv._packed, STENCIL_FUNC, code(compare_funcs, func, "stencil function"));
+  rv._stencil_ref = ref;
+  rv._stencil_value_mask = mask;
+  return rv;
+}
+
+RenderState RenderState::stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass) const {
+  auto rv = *this;
+  set(rv._packed, STENCIL_FAIL, code(stencil_ops, stencil_fail, "stencil operation"));
+  set(rv._packed, STENCIL_DEPTH_FAIL, code(stencil_ops, depth_fail, "stencil operation"));
+  set(rv._packed, STENCIL_DEPTH_PASS, code(stencil_ops, depth_pass, "stencil operation"));
+  return rv;
+}
+
+RenderState RenderState::stencil_mask(GLuint mask) const {
+  auto rv = *this;
+  rv._stencil_write_mask = mask;
+  return rv;
+}
+
+
+GLenum RenderState::depth_func() const {
+  return compare_func_of(_packed, DEPTH_FUNC);
+}
+
+bool RenderState::depth_mask() const {
+  return get(_packed, DEPTH_MASK);
+}
+
+GLenum RenderState::cull_face() const {
+  return faces[get(_packed, CULL_FACE)];
+}
+
+GLenum RenderState::front_face() const {
+  return windings[get(_packed, FRONT_FACE)];
+}
+
+
+bool RenderState::operator==(RenderState const& o) const {
+  return _enabled == o._enabled
+    && _packed == o._packed
+    && _polygon_offset_factor == o._polygon_offset_factor
+    && _polygon_offset_units == o._polygon_offset_units
+    && _stencil_ref == o._stencil_ref
+    && _stencil_value_mask == o._stencil_value_mask
+    && _stencil_write_mask == o._stencil_write_mask;
+}
+
+size_t RenderState::hash() const {
+  size_t seed = _enabled;
+  hash_combine(seed, std::hash<uint64_t>()(_packed));
+  hash_combine(seed, std::hash<float>()(_polygon_offset_factor));
+  hash_combine(seed, std::hash<float>()(_polygon_offset_units));
+  hash_combine(seed, _stencil_ref);
+  hash_combine(seed, _stencil_value_mask);
+  hash_combine(seed, _stencil_write_mask);
+  return seed;
+}
+
+
+void RenderState::apply() const {
+  for (unsigned i = 0; i < CAPABILITY_INDEX_MAX; ++i) {
+    auto index = CapabilityIndex(i);
+    set_capability(index, _enabled & bit(index));
+  }
+  apply_packed(~uint64_t(0));
+  GL_CALL(glPolygonOffset(_polygon_offset_factor, _polygon_offset_units));
+  GL_CALL(glStencilFunc(compare_func_of(_packed, STENCIL_FUNC), _stencil_ref, _stencil_value_mask));
+  GL_CALL(glStencilMask(_stencil_write_mask));
+}
+
+void RenderState::apply(RenderState const& current, uint32_t unknown_capabilities) const {
+  auto changed = (_enabled ^ current._enabled) | unknown_capabilities;
+  changed &= (1u << CAPABILITY_INDEX_MAX) - 1;
+  for (unsigned i = 0; changed; ++i, changed >>= 1) {
+    if (changed & 1) {
+      auto index = CapabilityIndex(i);
+      set_capability(index, _enabled & bit(index));
+    }
+  }
+
+  if (auto packed_changed = _packed ^ current._packed) {
+    apply_packed(packed_changed);
+  }
+  if (_polygon_offset_factor != current._polygon_offset_factor
+    || _polygon_offset_units != current._polygon_offset_units) {
+    GL_CALL(glPolygonOffset(_polygon_offset_factor, _polygon_offset_units));
+  }
+  if (_stencil_ref != current._stencil_ref
+    || _stencil_value_mask != current._stencil_value_mask
+    || (_packed ^ current._packed) & STENCIL_FUNC.mask()) {
+    GL_CALL(glStencilFunc(compare_func_of(_packed, STENCIL_FUNC), _stencil_ref, _stencil_value_mask));
+  }
+  if (_stencil_write_mask != current._stencil_write_mask) {
+    GL_CALL(glStencilMask(_stencil_write_mask));
+  }
+}
+
+void RenderState::apply_packed(uint64_t changed) const {
+  if (changed & BLEND_FUNC_FIELDS) {
+    GL_CALL(glBlendFuncSeparate(
+      blend_factor_of(_packed, BLEND_SRC_RGB), blend_factor_of(_packed, BLEND_DST_RGB),
+      blend_factor_of(_packed, BLEND_SRC_ALPHA), blend_factor_of(_packed, BLEND_DST_ALPHA)));
+  }
+  if (changed & BLEND_EQUATION_FIELDS) {
+    GL_CALL(glBlendEquationSeparate(blend_equation_of(_packed, BLEND_EQUATION_RGB), blend_equation_of(_packed, BLEND_EQUATION_ALPHA)));
+  }
+  if (changed & DEPTH_FUNC.mask()) {
+    GL_CALL(glDepthFunc(depth_func()));
+  }
+  if (changed & DEPTH_MASK.mask()) {
+    GL_CALL(glDepthMask(depth_mask()));
+  }
+  if (changed & CULL_FACE.mask()) {
+    GL_CALL(glCullFace(cull_face()));
+  }
+  if (changed & FRONT_FACE.mask()) {
+    GL_CALL(glFrontFace(front_face()));
+  }
+  if (changed & COLOR_MASK.mask()) {
+    auto mask = get(_packed, COLOR_MASK);
+    GL_CALL(glColorMask(mask & 1, mask & 2, mask & 4, mask & 8));
+  }
+  if (changed & STENCIL_OP_FIELDS) {
+    GL_CALL(glStencilOp(stencil_op_of(_packed, STENCIL_FAIL), stencil_op_of(_packed, STENCIL_DEPTH_FAIL), stencil_op_of(_packed, STENCIL_DEPTH_PASS)));
+  }
+}
+
+
+} // namespace gl
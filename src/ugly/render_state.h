@@ -0,0 +1,127 @@
+#ifndef UGLY_RENDER_STATE_H
+#define UGLY_RENDER_STATE_H
+
+#include "gl_type.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace gl {
+
+
+/**
+ * @brief the index of an enable/disable capability in CapabilityIndex, or
+ * CAPABILITY_INDEX_MAX if it isn't one Context::enable is instantiated for.
+ **/
+CapabilityIndex capability_index(GLenum capability);
+
+/**
+ * @brief the GLenum for a CapabilityIndex.
+ **/
+GLenum capability(CapabilityIndex);
+
+
+/**
+ * @brief an immutable bundle of fixed-function state: the enabled capabilities
+ * plus blend, depth, face culling, polygon offset, color mask and stencil
+ * parameters.
+ *
+ * A default-constructed RenderState holds the GL defaults. The setters return
+ * a modified copy, so states are built once and reused:
+ *
+ *   auto const opaque = RenderState().enable(GL_DEPTH_TEST).enable(GL_CULL_FACE);
+ *   auto const glass = opaque.enable(GL_BLEND).blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+ *
+ * Pass them to Context::apply(), which only issues the GL calls for the parts
+ * that differ from the last RenderState it applied. Everything but the polygon
+ * offset and the stencil reference and masks is packed into two words, so
+ * applying a state that matches the current one costs a few integer compares.
+ * The setters throw a gl::exception for an enum the GL call would reject.
+ **/
+class RenderState {
+  public:
+    RenderState();
+
+  public: // capabilities
+    RenderState enable(GLenum capability) const;
+    RenderState disable(GLenum capability) const;
+    bool is_enabled(GLenum capability) const;
+
+  public: // parameters
+    RenderState blend_func(GLenum src, GLenum dst) const;
+    RenderState blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) const;
+    RenderState blend_equation(GLenum mode) const;
+    RenderState blend_equation(GLenum mode_rgb, GLenum mode_alpha) const;
+    RenderState depth_func(GLenum func) const;
+    RenderState depth_mask(bool write) const;
+    RenderState cull_face(GLenum mode) const;
+    RenderState front_face(GLenum mode) const;
+    RenderState polygon_offset(float factor, float units) const;
+    RenderState color_mask(bool r, bool g, bool b, bool a) const;
+    RenderState stencil_func(GLenum func, GLint ref, GLuint mask) const;
+    RenderState stencil_op(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass) const;
+    RenderState stencil_mask(GLuint mask) const;
+
+  public:
+    GLenum depth_func() const;
+    bool depth_mask() const;
+    GLenum cull_face() const;
+    GLenum front_face() const;
+    GLuint stencil_mask() const { return _stencil_write_mask; }
+
+  public:
+    bool operator==(RenderState const&) const;
+    bool operator!=(RenderState const& other) const { return !(*this == other); }
+    size_t hash() const;
+
+  private:
+    friend class Context;
+
+    void set_enabled(CapabilityIndex, bool);
+    bool enabled(CapabilityIndex index) const { return _enabled & (1u << index); }
+
+    /**
+     * @brief issue every GL call needed to establish this state.
+     **/
+    void apply() const;
+
+    /**
+     * @brief issue only the GL calls needed to get from `current` to this state.
+     * Capabilities whose bit is set in `unknown_capabilities` are set regardless.
+     **/
+    void apply(RenderState const& current, uint32_t unknown_capabilities = 0) const;
+
+    /**
+     * @brief issue the GL calls for the _packed fields whose bits are set in `changed`.
+     **/
+    void apply_packed(uint64_t changed) const;
+
+  private:
+    uint32_t _enabled; // one bit per CapabilityIndex
+    uint64_t _packed; // blend, depth, face, color mask and stencil op settings as small codes
+
+    float _polygon_offset_factor;
+    float _polygon_offset_units;
+
+    GLint _stencil_ref;
+    GLuint _stencil_value_mask;
+    GLuint _stencil_write_mask;
+
+};
+
+
+} // namespace gl
+
+
+namespace std {
+
+template<>
+struct hash<gl::RenderState> {
+  size_t operator()(gl::RenderState const& state) const {
+    return state.hash();
+  }
+};
+
+}
+
+#endif
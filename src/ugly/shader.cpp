@@ -1,5 +1,6 @@
 #include "shader.h"
 #include "log.h"
+#include "name_pool.h"
 
 #include <iostream>
 #include <fstream>
@@ -9,11 +10,51 @@
 namespace gl {
 
 
+namespace {
+
+void delete_shaders(GLsizei n, GLuint const* names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    glDeleteShader(names[i]);
+  }
+}
+
+void forget_shader(StateCache&, GLuint) {}
+
+const detail::NameKind shader_kind = { nullptr, delete_shaders, forget_shader, true };
+
+}
+
+
 Shader::Shader() {}
 
 
 Shader::~Shader() {
-  GL_CALL(glDeleteShader(_name));
+  release();
+}
+
+Shader::Shader(Shader&& other) noexcept
+  : _name(other._name)
+  , _context(std::move(other._context))
+{
+  other._name = 0;
+}
+
+Shader& Shader::operator=(Shader&& other) noexcept {
+  if (this != &other) {
+    release();
+    _name = other._name;
+    _context = std::move(other._context);
+    other._name = 0;
+  }
+  return *this;
+}
+
+void Shader::release() {
+  if (_name) {
+    detail::release_name(_context, shader_kind, _name);
+    _context.reset();
+    _name = 0;
+  }
 }
 
 
@@ -32,6 +73,7 @@ std::string load_file(std::string const& path) {
 template<GLenum Type>
 Shader_type<Type>::Shader_type() {
   GL_CALL(_name = glCreateShader(Type));
+  _context = detail::current_deletion_queue();
 }
 
 template<GLenum Type>
@@ -150,6 +192,9 @@ template class Shader_type<GL_VERTEX_SHADER>;
 template class Shader_type<GL_TESS_CONTROL_SHADER>;
 template class Shader_type<GL_TESS_EVALUATION_SHADER>;
 template class Shader_type<GL_GEOMETRY_SHADER>;
+#ifdef GL_VERSION_4_3
+template class Shader_type<GL_COMPUTE_SHADER>;
+#endif
 
 } // namespace gl
 
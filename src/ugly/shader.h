@@ -2,11 +2,17 @@
 #define SHADER_H
 
 #include "gl_type.h"
+#include <memory>
 #include <string>
 
 namespace gl {
 
 
+namespace detail {
+class DeletionQueue;
+}
+
+
 class Shader {
   public:
     Shader();
@@ -15,6 +21,8 @@ class Shader {
     virtual ~Shader() =0;
     Shader& operator=(Shader const&) = delete;
     Shader(Shader const&) = delete;
+    Shader(Shader&&) noexcept;
+    Shader& operator=(Shader&&) noexcept;
 
   public:
     void set_source(std::string const& source);
@@ -31,8 +39,12 @@ class Shader {
     bool compiled() const;
     unsigned source_length() const;
 
+  protected:
+    void release();
+
   protected:
     GLuint _name;
+    std::shared_ptr<detail::DeletionQueue> _context;  // see GeneratedObject
 
 };
 
@@ -50,6 +62,8 @@ class Shader_type : public Shader {
 
   public:
     ~Shader_type() override {}
+    Shader_type(Shader_type&&) = default;
+    Shader_type& operator=(Shader_type&&) = default;
 
 };
 
@@ -59,6 +73,9 @@ typedef Shader_type<GL_VERTEX_SHADER> VertexShader;
 typedef Shader_type<GL_TESS_CONTROL_SHADER> TessControlShader;
 typedef Shader_type<GL_TESS_EVALUATION_SHADER> TessEvaluationShader;
 typedef Shader_type<GL_GEOMETRY_SHADER> GeometryShader;
+#ifdef GL_VERSION_4_3
+typedef Shader_type<GL_COMPUTE_SHADER> ComputeShader;
+#endif
 
 
 }
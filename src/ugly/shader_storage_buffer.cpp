@@ -0,0 +1,28 @@
+#include "shader_storage_buffer.h"
+#include "uniform_buffer.h"
+#include "state_cache.h"
+
+#ifdef GL_VERSION_4_3
+
+using namespace gl;
+
+ShaderStorageBuffer::ShaderStorageBuffer() {}
+
+ShaderStorageBuffer::~ShaderStorageBuffer() {}
+
+void ShaderStorageBuffer::bind(GLuint binding) const {
+  GL_CALL(glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER,
+    binding,
+    _buffer.name()
+  ));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(GL_SHADER_STORAGE_BUFFER, _buffer.name());
+  }
+}
+
+void ShaderStorageBuffer::bind(GLuint binding, size_t offset, size_t size) const {
+  detail::bind_buffer_range(GL_SHADER_STORAGE_BUFFER, binding, _buffer, offset, size);
+}
+
+#endif
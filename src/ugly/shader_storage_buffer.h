@@ -0,0 +1,70 @@
+#ifndef UGLY_SHADER_STORAGE_BUFFER_H
+#define UGLY_SHADER_STORAGE_BUFFER_H
+
+#include "buffer.h"
+#include <vector>
+#include <array>
+
+#ifdef GL_VERSION_4_3
+
+namespace gl {
+
+
+/**
+ * @brief a Buffer backing shader storage blocks (GL 4.3): like a UniformBuffer,
+ * but as big as the Buffer can be, and writable from shaders. Use
+ * Context::memory_barrier() before reading what a shader wrote.
+ **/
+class ShaderStorageBuffer {
+  public:
+    ShaderStorageBuffer();
+
+  public:
+    ~ShaderStorageBuffer();
+    ShaderStorageBuffer(ShaderStorageBuffer const&) = delete;
+    ShaderStorageBuffer& operator=(ShaderStorageBuffer const&) = delete;
+    ShaderStorageBuffer(ShaderStorageBuffer&&) = default;
+    ShaderStorageBuffer& operator=(ShaderStorageBuffer&&) = default;
+
+  public:
+    template<typename T>
+    void data(std::vector<T> const& container, GLenum usage) {
+      _buffer.data(container, usage, GL_SHADER_STORAGE_BUFFER);
+    }
+
+    template<typename T, size_t N>
+    void data(std::array<T, N> const& container, GLenum usage) {
+      _buffer.data(container, usage, GL_SHADER_STORAGE_BUFFER);
+    }
+
+    void data(GLsizei size, GLenum usage) {
+      _buffer.data(size, usage, GL_SHADER_STORAGE_BUFFER);
+    }
+
+    template<typename Container>
+    void subdata(size_t offset, size_t count, Container const& container) {
+      _buffer.subdata(offset, count, container, GL_SHADER_STORAGE_BUFFER);
+    }
+
+    void bind(GLuint binding) const;
+
+    /**
+     * @brief bind `size` bytes from `offset` to `binding`. `offset` must be a
+     * multiple of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT.
+     **/
+    void bind(GLuint binding, size_t offset, size_t size) const;
+
+    Buffer& buffer() { return _buffer; }
+    Buffer const& buffer() const { return _buffer; }
+
+  private:
+    Buffer _buffer;
+
+};
+
+
+}
+
+#endif
+
+#endif
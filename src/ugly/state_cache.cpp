@@ -0,0 +1,256 @@
+#include "state_cache.h"
+
+namespace gl {
+
+
+namespace {
+
+BufferIndex buffer_index(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER: return BUFFER_INDEX_ARRAY;
+#ifdef GL_VERSION_4_2
+    case GL_ATOMIC_COUNTER_BUFFER: return BUFFER_INDEX_ATOMIC_COUNTER;
+#endif
+    case GL_COPY_READ_BUFFER: return BUFFER_INDEX_COPY_READ;
+    case GL_COPY_WRITE_BUFFER: return BUFFER_INDEX_COPY_WRITE;
+#ifdef GL_VERSION_4_3
+    case GL_DISPATCH_INDIRECT_BUFFER: return BUFFER_INDEX_DISPATCH_INDIRECT;
+#endif
+    case GL_DRAW_INDIRECT_BUFFER: return BUFFER_INDEX_DRAW_INDIRECT;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_INDEX_ELEMENT_ARRAY;
+    case GL_PIXEL_PACK_BUFFER: return BUFFER_INDEX_PIXEL_PACK;
+    case GL_PIXEL_UNPACK_BUFFER: return BUFFER_INDEX_PIXEL_UNPACK;
+#ifdef GL_VERSION_4_4
+    case GL_QUERY_BUFFER: return BUFFER_INDEX_QUERY;
+#endif
+#ifdef GL_VERSION_4_3
+    case GL_SHADER_STORAGE_BUFFER: return BUFFER_INDEX_SHADER_STORAGE;
+#endif
+    case GL_TEXTURE_BUFFER: return BUFFER_INDEX_TEXTURE;
+    case GL_TRANSFORM_FEEDBACK_BUFFER: return BUFFER_INDEX_TRANSFORM_FEEDBACK;
+    case GL_UNIFORM_BUFFER: return BUFFER_INDEX_UNIFORM;
+    default: return BUFFER_INDEX_MAX;
+  }
+}
+
+TextureIndex texture_index(GLenum target) {
+  switch (target) {
+    case GL_TEXTURE_1D: return TEXTURE_INDEX_1D;
+    case GL_TEXTURE_1D_ARRAY: return TEXTURE_INDEX_1D_ARRAY;
+    case GL_TEXTURE_2D: return TEXTURE_INDEX_2D;
+    case GL_TEXTURE_2D_ARRAY: return TEXTURE_INDEX_2D_ARRAY;
+    case GL_TEXTURE_2D_MULTISAMPLE: return TEXTURE_INDEX_2D_MULTISAMPLE;
+    case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return TEXTURE_INDEX_2D_MULTISAMPLE_ARRAY;
+    case GL_TEXTURE_3D: return TEXTURE_INDEX_3D;
+    case GL_TEXTURE_BUFFER: return TEXTURE_INDEX_BUFFER;
+    case GL_TEXTURE_CUBE_MAP: return TEXTURE_INDEX_CUBE_MAP;
+    case GL_TEXTURE_CUBE_MAP_ARRAY: return TEXTURE_INDEX_CUBE_MAP_ARRAY;
+    case GL_TEXTURE_RECTANGLE: return TEXTURE_INDEX_RECTANGLE;
+    default: return TEXTURE_INDEX_MAX;
+  }
+}
+
+template<size_t N>
+void forget(std::array<GLuint, N>& slots, GLuint name) {
+  for (auto& slot : slots) {
+    if (slot == name) {
+      slot = StateCache::UNKNOWN;
+    }
+  }
+}
+
+inline void forget(GLuint& slot, GLuint name) {
+  if (slot == name) {
+    slot = StateCache::UNKNOWN;
+  }
+}
+
+}
+
+
+GLuint const StateCache::UNKNOWN;
+
+
+StateCache::StateCache() {
+  invalidate();
+}
+
+void StateCache::invalidate() {
+  _buffers.fill(UNKNOWN);
+  _textures.clear();
+  _active_texture = UNKNOWN;
+  _program = UNKNOWN;
+  _vertex_array = UNKNOWN;
+  _draw_framebuffer = UNKNOWN;
+  _read_framebuffer = UNKNOWN;
+  _renderbuffer = UNKNOWN;
+  _viewport_known = false;
+}
+
+
+bool StateCache::set(GLuint& slot, GLuint name) {
+  if (slot == name) {
+    ++_stats.elided;
+    return false;
+  }
+  slot = name;
+  ++_stats.issued;
+  return true;
+}
+
+StateCache::TextureSlots& StateCache::unit_slots() {
+  if (_textures.size() <= _active_texture) {
+    TextureSlots unknown;
+    unknown.fill(UNKNOWN);
+    _textures.resize(_active_texture + 1, unknown);
+  }
+  return _textures[_active_texture];
+}
+
+
+GLuint StateCache::bound_buffer(GLenum target) const {
+  auto index = buffer_index(target);
+  return index == BUFFER_INDEX_MAX ? UNKNOWN : _buffers[index];
+}
+
+GLuint StateCache::bound_texture(GLenum target) const {
+  auto index = texture_index(target);
+  if (index == TEXTURE_INDEX_MAX || _active_texture >= _textures.size()) {
+    return UNKNOWN;
+  }
+  return _textures[_active_texture][index];
+}
+
+GLuint StateCache::bound_framebuffer(GLenum target) const {
+  switch (target) {
+    case GL_DRAW_FRAMEBUFFER: return _draw_framebuffer;
+    case GL_READ_FRAMEBUFFER: return _read_framebuffer;
+    default:
+      return _draw_framebuffer == _read_framebuffer ? _draw_framebuffer : UNKNOWN;
+  }
+}
+
+
+void StateCache::bind_buffer(GLenum target, GLuint name) {
+  auto index = buffer_index(target);
+  if (index == BUFFER_INDEX_MAX) {
+    ++_stats.issued;
+    GL_CALL(glBindBuffer(target, name));
+  } else if (set(_buffers[index], name)) {
+    GL_CALL(glBindBuffer(target, name));
+  }
+}
+
+void StateCache::bind_texture(GLenum target, GLuint name) {
+  auto index = texture_index(target);
+  if (index == TEXTURE_INDEX_MAX || _active_texture == UNKNOWN) {
+    ++_stats.issued;
+    GL_CALL(glBindTexture(target, name));
+  } else if (set(unit_slots()[index], name)) {
+    GL_CALL(glBindTexture(target, name));
+  }
+}
+
+void StateCache::bind_framebuffer(GLenum target, GLuint name) {
+  switch (target) {
+    case GL_DRAW_FRAMEBUFFER:
+      if (set(_draw_framebuffer, name)) {
+        GL_CALL(glBindFramebuffer(target, name));
+      }
+      break;
+    case GL_READ_FRAMEBUFFER:
+      if (set(_read_framebuffer, name)) {
+        GL_CALL(glBindFramebuffer(target, name));
+      }
+      break;
+    default: // GL_FRAMEBUFFER binds both
+      if (_draw_framebuffer == name && _read_framebuffer == name) {
+        ++_stats.elided;
+      } else {
+        ++_stats.issued;
+        _draw_framebuffer = _read_framebuffer = name;
+        GL_CALL(glBindFramebuffer(target, name));
+      }
+      break;
+  }
+}
+
+void StateCache::bind_renderbuffer(GLenum target, GLuint name) {
+  if (set(_renderbuffer, name)) {
+    GL_CALL(glBindRenderbuffer(target, name));
+  }
+}
+
+void StateCache::active_texture(GLuint unit) {
+  if (set(_active_texture, unit)) {
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+  }
+}
+
+void StateCache::use_program(GLuint name) {
+  if (set(_program, name)) {
+    GL_CALL(glUseProgram(name));
+  }
+}
+
+void StateCache::bind_vertex_array(GLuint name) {
+  if (set(_vertex_array, name)) {
+    // the element array binding belongs to the vertex array
+    _buffers[BUFFER_INDEX_ELEMENT_ARRAY] = UNKNOWN;
+    GL_CALL(glBindVertexArray(name));
+  }
+}
+
+void StateCache::viewport(Viewport const& viewport) {
+  if (_viewport_known && _viewport == viewport) {
+    ++_stats.elided;
+    return;
+  }
+  ++_stats.issued;
+  _viewport = viewport;
+  _viewport_known = true;
+  GL_CALL(glViewport(viewport.x, viewport.y, viewport.width, viewport.height));
+}
+
+
+void StateCache::note_buffer(GLenum target, GLuint name) {
+  auto index = buffer_index(target);
+  if (index != BUFFER_INDEX_MAX) {
+    _buffers[index] = name;
+  }
+}
+
+
+void StateCache::forget_buffer(GLuint name) {
+  forget(_buffers, name);
+}
+
+void StateCache::forget_texture(GLuint name) {
+  for (auto& slots : _textures) {
+    forget(slots, name);
+  }
+}
+
+void StateCache::forget_framebuffer(GLuint name) {
+  forget(_draw_framebuffer, name);
+  forget(_read_framebuffer, name);
+}
+
+void StateCache::forget_renderbuffer(GLuint name) {
+  forget(_renderbuffer, name);
+}
+
+void StateCache::forget_vertex_array(GLuint name) {
+  if (_vertex_array == name) {
+    _vertex_array = UNKNOWN;
+    _buffers[BUFFER_INDEX_ELEMENT_ARRAY] = UNKNOWN;
+  }
+}
+
+void StateCache::forget_program(GLuint name) {
+  forget(_program, name);
+}
+
+
+
+} // namespace gl
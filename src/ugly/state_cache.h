@@ -0,0 +1,154 @@
+#ifndef UGLY_STATE_CACHE_H
+#define UGLY_STATE_CACHE_H
+
+#include "gl_type.h"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace gl {
+
+
+/**
+ * @brief counts of binding calls that went to the driver vs. those that were
+ * skipped because the cached binding already matched.
+ **/
+struct BindingStats {
+  uint64_t issued { 0 };
+  uint64_t elided { 0 };
+};
+
+
+/**
+ * @brief what a Bindguard does with its target when it goes out of scope.
+ *
+ *  - BINDING_RESTORE_PREVIOUS: rebind whatever was bound when the guard was
+ *    created, so nested guards unwind like a stack. (default)
+ *  - BINDING_LEAVE_BOUND: leave the object bound; the next guard that needs
+ *    the same object costs nothing. A vertex array left bound would capture
+ *    the next GL_ELEMENT_ARRAY_BUFFER bind, so a BufferBindguard for that
+ *    target unbinds it first, unless a VertexArrayBindguard is alive (i.e.
+ *    the vertex array is being set up).
+ *  - BINDING_UNBIND: bind 0 (or the default). This is the old behaviour, and is
+ *    only useful for debugging code that relies on stale bindings.
+ **/
+enum BindingPolicy {
+  BINDING_RESTORE_PREVIOUS = 0,
+  BINDING_LEAVE_BOUND,
+  BINDING_UNBIND,
+};
+
+
+/**
+ * @brief a shadow copy of a Context's bindings.
+ *
+ * Every bind performed by the library goes through the StateCache of the Context
+ * current on the calling thread, so a bind that matches the cached value never
+ * reaches the driver. Values the cache can't vouch for are UNKNOWN, which always
+ * causes the next bind to be issued.
+ *
+ * If you call glBind* yourself, call Context::invalidate_state() afterwards.
+ **/
+class StateCache {
+  public:
+    static GLuint const UNKNOWN = ~0u;
+
+  public:
+    StateCache();
+
+  public:
+    /**
+     * @brief forget everything; the next bind of every kind will be issued.
+     **/
+    void invalidate();
+
+  public:
+    BindingPolicy policy() const { return _policy; }
+    void policy(BindingPolicy policy) { _policy = policy; }
+
+  public: // bound names, or UNKNOWN
+    GLuint bound_buffer(GLenum target) const;
+    GLuint bound_texture(GLenum target) const;
+    GLuint bound_framebuffer(GLenum target) const;
+    GLuint bound_renderbuffer() const { return _renderbuffer; }
+    GLuint active_texture() const { return _active_texture; }
+    GLuint program() const { return _program; }
+    GLuint vertex_array() const { return _vertex_array; }
+
+  public:
+    void bind_buffer(GLenum target, GLuint name);
+    void bind_texture(GLenum target, GLuint name);
+    void bind_framebuffer(GLenum target, GLuint name);
+    void bind_renderbuffer(GLenum target, GLuint name);
+    void active_texture(GLuint unit);
+    void use_program(GLuint name);
+    void bind_vertex_array(GLuint name);
+    void viewport(Viewport const&);
+
+    /**
+     * @brief count the VertexArrayBindguards alive; while there's none, the
+     * bound vertex array, if any, is only left over from BINDING_LEAVE_BOUND.
+     **/
+    void hold_vertex_array() { ++_vertex_array_holds; }
+    void release_vertex_array() { --_vertex_array_holds; }
+    bool vertex_array_held() const { return _vertex_array_holds > 0; }
+
+  public:
+    /**
+     * @brief record a binding made as the side effect of another call
+     * (e.g. glBindBufferBase also binds the generic target).
+     **/
+    void note_buffer(GLenum target, GLuint name);
+
+  public: // called when objects are deleted; GL unbinds them implicitly
+    void forget_buffer(GLuint name);
+    void forget_texture(GLuint name);
+    void forget_framebuffer(GLuint name);
+    void forget_renderbuffer(GLuint name);
+    void forget_vertex_array(GLuint name);
+    void forget_program(GLuint name);
+
+  public:
+    BindingStats const& stats() const { return _stats; }
+    void reset_stats() { _stats = BindingStats(); }
+
+  private:
+    using TextureSlots = std::array<GLuint, TEXTURE_INDEX_MAX>;
+
+    bool set(GLuint& slot, GLuint name);
+    TextureSlots& unit_slots();
+
+  private:
+    std::array<GLuint, BUFFER_INDEX_MAX> _buffers;
+    std::vector<TextureSlots> _textures;
+    GLuint _active_texture;
+    GLuint _program;
+    GLuint _vertex_array;
+    unsigned _vertex_array_holds { 0 };
+    GLuint _draw_framebuffer;
+    GLuint _read_framebuffer;
+    GLuint _renderbuffer;
+    Viewport _viewport;
+    bool _viewport_known { false };
+
+    BindingPolicy _policy { BINDING_RESTORE_PREVIOUS };
+    BindingStats _stats;
+
+};
+
+
+namespace detail {
+
+/**
+ * @brief the StateCache of the Context current on this thread, or nullptr if
+ * there isn't one (in which case binds go straight to the driver).
+ **/
+StateCache* current_state();
+
+}
+
+
+} // namespace gl
+
+#endif
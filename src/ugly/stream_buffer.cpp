@@ -0,0 +1,111 @@
+#include "stream_buffer.h"
+#include "context.h"
+#include "state_cache.h"
+
+namespace gl {
+
+
+namespace {
+
+inline size_t align_up(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+
+StreamBuffer::StreamBuffer(Context const& context, size_t size, unsigned max_frames /* = 3 */)
+  : _size(size)
+  , _alignment(std::max<size_t>(context.capabilities().uniform_buffer_offset_alignment, 1))
+  , _max_frames(std::max(max_frames, 1u))
+{
+  if (context.capabilities().version_at_least(4, 4)) {
+    _buffer.storage(size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+    _persistent = static_cast<char*>(_buffer.persistent_map());
+  } else {
+    _buffer.data(GLsizei(size), GL_STREAM_DRAW);
+  }
+}
+
+StreamBuffer::~StreamBuffer() {}
+
+
+void* StreamBuffer::allocate_bytes(size_t size, size_t alignment, size_t& offset) {
+  if (size > _size) {
+    throw gl::exception("can't allocate %u bytes from a StreamBuffer of %u", size, _size);
+  }
+
+  alignment = std::max(alignment, _alignment);
+  size_t start, padding;
+  for (;;) {
+    if (_used == 0) {
+      _head = 0;
+    }
+    start = align_up(_head, alignment);
+    if (start + size > _size) {
+      start = 0;
+    }
+    padding = start >= _head ? start - _head : _size - _head + start;
+    if (_used + padding + size <= _size) {
+      break;
+    }
+    if (_frames.empty()) {
+      throw gl::exception("StreamBuffer of %u bytes is too small for one frame", _size);
+    }
+    retire_oldest();
+  }
+
+  _head = start + size;
+  _used += padding + size;
+  _frame_bytes += padding + size;
+  offset = start;
+
+  if (_persistent) {
+    return _persistent + start;
+  }
+
+  flush();
+  void* p = _buffer.map_range(start, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+  if (!p) {
+    throw gl::exception("failed to map %u bytes of StreamBuffer %u", size, _buffer.name());
+  }
+  return p;
+}
+
+void StreamBuffer::retire_oldest() {
+  auto& frame = _frames.front();
+  frame.fence.wait();
+  _used -= frame.bytes;
+  _frames.pop_front();
+}
+
+
+void StreamBuffer::flush() {
+  if (!_persistent && _buffer.mapped()) {
+    _buffer.unmap();
+  }
+}
+
+void StreamBuffer::end_frame() {
+  flush();
+  _frames.push_back(Frame { Sync(), _frame_bytes });
+  _frame_bytes = 0;
+
+  while (_frames.size() > 1 && _frames.front().fence.signaled()) {
+    retire_oldest();
+  }
+  while (_frames.size() > _max_frames) {
+    retire_oldest();
+  }
+}
+
+
+void StreamBuffer::bind_range(GLenum target, GLuint index, size_t offset, size_t size) const {
+  GL_CALL(glBindBufferRange(target, index, _buffer.name(), offset, size));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(target, _buffer.name());
+  }
+}
+
+
+} // namespace gl
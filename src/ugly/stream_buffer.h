@@ -0,0 +1,124 @@
+#ifndef UGLY_STREAM_BUFFER_H
+#define UGLY_STREAM_BUFFER_H
+
+#include "gl_type.h"
+#include "buffer.h"
+#include "sync.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace gl {
+
+
+class Context;
+
+
+/**
+ * @brief a ring allocator over one large Buffer for data rewritten every
+ * frame: vertices, instance data, uniform blocks.
+ *
+ * allocate() hands out aligned ranges to write into directly; end_frame()
+ * fences everything allocated since the last end_frame(). Space is reused once
+ * the GPU has passed a frame's fence, so nothing is reallocated and the driver
+ * never has to sync implicitly. The CPU only blocks when the ring is full or
+ * more than `max_frames` frames are in flight.
+ *
+ * With GL 4.4 the Buffer is mapped persistently and coherently, once. Older
+ * versions map each allocation unsynchronized (the fences already make that
+ * safe), so there a pointer is only valid until the next allocate() or
+ * flush(). Call flush() before drawing with what was written either way.
+ **/
+class StreamBuffer {
+  public:
+    template<typename T>
+    struct Allocation {
+      span<T> data;
+      size_t offset;  // bytes, from the start of buffer()
+      size_t size;    // bytes
+    };
+
+  public:
+    /**
+     * @brief `size` bytes, shared by up to `max_frames` frames in flight.
+     * Allocations are aligned to at least the Context's
+     * GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, so any of them can be bound as a
+     * uniform block.
+     **/
+    StreamBuffer(Context const&, size_t size, unsigned max_frames = 3);
+    ~StreamBuffer();
+    StreamBuffer(StreamBuffer const&) = delete;
+    StreamBuffer& operator=(StreamBuffer const&) = delete;
+
+  public:
+    template<typename T>
+    Allocation<T> allocate(size_t count, size_t alignment = alignof(T)) {
+      size_t offset;
+      void* p = allocate_bytes(count * sizeof(T), alignment, offset);
+      return Allocation<T> { span<T>(static_cast<T*>(p), count), offset, count * sizeof(T) };
+    }
+
+    /**
+     * @brief copy `values` into a new allocation.
+     **/
+    template<typename T>
+    Allocation<T> write(std::vector<T> const& values) {
+      auto allocation = allocate<T>(values.size());
+      std::copy(values.begin(), values.end(), allocation.data.begin());
+      return allocation;
+    }
+
+    /**
+     * @brief finish writing: makes allocations so far visible to the GPU.
+     **/
+    void flush();
+
+    /**
+     * @brief fence the current frame's allocations and start the next frame,
+     * waiting for the oldest frame if there are too many in flight.
+     **/
+    void end_frame();
+
+  public:
+    /**
+     * @brief bind an allocation to an indexed target with glBindBufferRange.
+     **/
+    template<typename T>
+    void bind(GLenum target, GLuint index, Allocation<T> const& allocation) const {
+      bind_range(target, index, allocation.offset, allocation.size);
+    }
+
+    void bind_range(GLenum target, GLuint index, size_t offset, size_t size) const;
+
+    Buffer const& buffer() const { return _buffer; }
+    size_t size() const { return _size; }
+    size_t alignment() const { return _alignment; }
+    size_t frames_in_flight() const { return _frames.size(); }
+
+  private:
+    struct Frame {
+      Sync fence;
+      size_t bytes;
+    };
+
+    void* allocate_bytes(size_t size, size_t alignment, size_t& offset);
+    void retire_oldest();
+
+  private:
+    Buffer _buffer;
+    size_t _size;
+    size_t _alignment;
+    unsigned _max_frames;
+    char* _persistent { nullptr };
+
+    size_t _head { 0 };        // where the next allocation starts looking
+    size_t _used { 0 };        // bytes allocated and not yet retired
+    size_t _frame_bytes { 0 }; // bytes allocated in the current frame
+    std::deque<Frame> _frames;
+
+};
+
+
+} // namespace gl
+
+#endif
@@ -0,0 +1,86 @@
+#include "sync.h"
+
+#include <utility>
+
+namespace gl {
+
+
+Sync::Sync() {
+  GL_CALL(_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+Sync::Sync(std::nullptr_t) {}
+
+Sync::~Sync() {
+  release();
+}
+
+Sync::Sync(Sync&& other)
+  : _sync(other._sync)
+  , _signaled(other._signaled)
+{
+  other._sync = nullptr;
+  other._signaled = false;
+}
+
+Sync& Sync::operator=(Sync&& other) {
+  if (this != &other) {
+    release();
+    std::swap(_sync, other._sync);
+    std::swap(_signaled, other._signaled);
+  }
+  return *this;
+}
+
+void Sync::release() {
+  if (_sync) {
+    GL_CALL_NOTHROW(glDeleteSync(_sync));
+    _sync = nullptr;
+  }
+  _signaled = false;
+}
+
+void Sync::reset() {
+  release();
+  GL_CALL(_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+
+bool Sync::signaled() const {
+  if (!_sync || _signaled) {
+    return true;
+  }
+  GLint status = GL_UNSIGNALED;
+  GL_CALL(glGetSynciv(_sync, GL_SYNC_STATUS, 1, nullptr, &status));
+  _signaled = status == GL_SIGNALED;
+  return _signaled;
+}
+
+bool Sync::wait(GLuint64 timeout /* = FOREVER */) const {
+  if (!_sync || _signaled) {
+    return true;
+  }
+
+  GLenum result;
+  GL_CALL(result = glClientWaitSync(_sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout));
+  switch (result) {
+    case GL_ALREADY_SIGNALED:
+    case GL_CONDITION_SATISFIED:
+      _signaled = true;
+      return true;
+    case GL_TIMEOUT_EXPIRED:
+      return false;
+    default:
+      throw gl::exception("glClientWaitSync failed");
+  }
+}
+
+void Sync::server_wait() const {
+  if (!_sync || _signaled) {
+    return;
+  }
+  GL_CALL(glWaitSync(_sync, 0, GL_TIMEOUT_IGNORED));
+}
+
+
+} // namespace gl
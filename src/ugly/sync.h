@@ -0,0 +1,78 @@
+#ifndef UGLY_SYNC_H
+#define UGLY_SYNC_H
+
+#include "gl_type.h"
+
+#include <cstddef>
+
+namespace gl {
+
+
+/**
+ * @brief a fence in the GL command stream, wrapping glFenceSync.
+ *
+ * Constructing a Sync inserts the fence; it signals once the GPU has
+ * completed every command issued before it. Syncs are shared between
+ * Contexts that share objects, so one Context can wait on another's fence.
+ *
+ * A moved-from Sync is empty: it counts as signaled and waits return at once.
+ **/
+class Sync {
+  public:
+    static GLuint64 const FOREVER = ~GLuint64(0);
+
+  public:
+    Sync();
+
+    /**
+     * @brief an empty Sync, as if moved from, until reset().
+     **/
+    explicit Sync(std::nullptr_t);
+
+    ~Sync();
+    Sync(Sync&&);
+    Sync& operator=(Sync&&);
+    Sync(Sync const&) = delete;
+    Sync& operator=(Sync const&) = delete;
+
+  public:
+    /**
+     * @brief whether the GPU has passed the fence, without blocking.
+     **/
+    bool signaled() const;
+
+    /**
+     * @brief block the calling thread until the fence signals or `timeout`
+     * nanoseconds pass, flushing first so the fence is sure to be reached.
+     * Returns whether the fence signaled.
+     **/
+    bool wait(GLuint64 timeout = FOREVER) const;
+
+    /**
+     * @brief make the GPU wait for the fence before running any commands
+     * issued after this, without blocking the calling thread. Useful across
+     * Contexts; the Context that inserted the fence must have flushed.
+     **/
+    void server_wait() const;
+
+    /**
+     * @brief replace the fence with a new one at the current point.
+     **/
+    void reset();
+
+    bool empty() const { return _sync == nullptr; }
+    GLsync handle() const { return _sync; }
+
+  private:
+    void release();
+
+  private:
+    GLsync _sync { nullptr };
+    mutable bool _signaled { false };
+
+};
+
+
+} // namespace gl
+
+#endif
@@ -163,6 +163,10 @@ Texture::Texture(GLuint name, GLenum target, GLenum internal_format)
 
 Texture::~Texture() {}
 
+Texture::Texture(Texture&&) = default;
+
+Texture& Texture::operator=(Texture&&) = default;
+
 
 void Texture::parameter(GLenum pname, float value) {
   TextureBindguard guard(_target, *this);
@@ -93,6 +93,8 @@ class Texture : public GeneratedObject<glGenTextures, glDeleteTextures> {
   public:
     Texture(Texture const&) = delete;
     Texture& operator=(Texture const&) = delete;
+    Texture(Texture&&);
+    Texture& operator=(Texture&&);
     ~Texture();
 
   public:
@@ -108,7 +110,7 @@ class Texture : public GeneratedObject<glGenTextures, glDeleteTextures> {
     GLenum target() const;
 
   protected:
-    GLenum const _target;
+    GLenum _target;
     GLenum _internal_format;
 
 };
@@ -230,6 +232,11 @@ class Cubemap : public Texture {
     explicit Cubemap(GLenum internal_format = GL_RGBA);
     Cubemap(TextureParams const& params, GLenum internal_format = GL_RGBA);
 
+    // The faces alias the cubemap's name without owning it, so moving them
+    // along with the cubemap keeps them pointing at the same texture.
+    Cubemap(Cubemap&&) = default;
+    Cubemap& operator=(Cubemap&&) = default;
+
   public:
     Face& operator[](FaceIndex i);
     Face const& operator[](FaceIndex i) const;
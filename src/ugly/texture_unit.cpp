@@ -1,5 +1,7 @@
 #include "texture_unit.h"
 #include "texture.h"
+#include "state_cache.h"
+#include "context_impl.h"
 
 using namespace gl;
 
@@ -31,7 +33,12 @@ void release_unit(unsigned unit) {
 
 
 TextureUnit::TextureUnit(): _unit(next_unit()) {
-  // assert _unit < GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS
+  auto impl = Context_impl::current_on_thread();
+  if (impl && _unit >= impl->_capabilities.max_combined_texture_image_units) {
+    release_unit(_unit);
+    throw gl::exception("out of texture units: %u available",
+      impl->_capabilities.max_combined_texture_image_units);
+  }
 }
 
 TextureUnit::~TextureUnit() {
@@ -40,7 +47,11 @@ TextureUnit::~TextureUnit() {
 
 void TextureUnit::add(Texture const& texture) {
   ActiveTextureBindguard guard(*this);
-  GL_CALL(glBindTexture(texture.target(), texture.name()));
+  if (auto state = detail::current_state()) {
+    state->bind_texture(texture.target(), texture.name());
+  } else {
+    GL_CALL(glBindTexture(texture.target(), texture.name()));
+  }
 }
 
 GLenum TextureUnit::unit() const {
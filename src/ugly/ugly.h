@@ -9,9 +9,18 @@
 #include "ugly/texture_unit.h"
 #include "ugly/enum.h"
 #include "ugly/buffer.h"
+#include "ugly/buffer_heap.h"
+#include "ugly/block_layout.h"
 #include "ugly/uniform_buffer.h"
+#include "ugly/shader_storage_buffer.h"
+#include "ugly/atomic_counter_buffer.h"
+#include "ugly/stream_buffer.h"
 #include "ugly/framebuffer.h"
 #include "ugly/vertex_array.h"
 #include "ugly/renderbuffer.h"
+#include "ugly/render_state.h"
+#include "ugly/sync.h"
+#include "ugly/command_buffer.h"
+#include "ugly/upload_queue.h"
 
 #endif
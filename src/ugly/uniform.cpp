@@ -4,8 +4,10 @@
 #include "gl_type.h"
 #include "program.h"
 #include "texture_unit.h"
+#include "enum.h"
 
 #include <functional>
+#include <tuple>
 
 namespace gl {
 
@@ -25,16 +27,94 @@ GLint untyped_uniform::location() const {
 
 namespace detail {
 
+
+namespace {
+
+// The GL type of a uniform set from N values of type T, and the boolean type
+// it can also be set to.
+GLenum vector_type(GLfloat, size_t n) {
+  const GLenum types[] = { GL_FLOAT, GL_FLOAT_VEC2, GL_FLOAT_VEC3, GL_FLOAT_VEC4 };
+  return types[n - 1];
+}
+
+GLenum vector_type(GLint, size_t n) {
+  const GLenum types[] = { GL_INT, GL_INT_VEC2, GL_INT_VEC3, GL_INT_VEC4 };
+  return types[n - 1];
+}
+
+GLenum vector_type(GLuint, size_t n) {
+  const GLenum types[] = { GL_UNSIGNED_INT, GL_UNSIGNED_INT_VEC2, GL_UNSIGNED_INT_VEC3, GL_UNSIGNED_INT_VEC4 };
+  return types[n - 1];
+}
+
+GLenum bool_type(size_t n) {
+  const GLenum types[] = { GL_BOOL, GL_BOOL_VEC2, GL_BOOL_VEC3, GL_BOOL_VEC4 };
+  return types[n - 1];
+}
+
+GLenum matrix_type(unsigned columns, unsigned rows) {
+  const GLenum types[3][3] = {
+    { GL_FLOAT_MAT2, GL_FLOAT_MAT2x3, GL_FLOAT_MAT2x4 },
+    { GL_FLOAT_MAT3x2, GL_FLOAT_MAT3, GL_FLOAT_MAT3x4 },
+    { GL_FLOAT_MAT4x2, GL_FLOAT_MAT4x3, GL_FLOAT_MAT4 },
+  };
+  return types[columns - 2][rows - 2];
+}
+
+// Samplers and images, which are set with glUniform1i.
+bool opaque_type(GLenum type) {
+  switch (type) {
+    case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+    case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+    case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+    case GL_BOOL: case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+    case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+    case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+    case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+    case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+      return false;
+    default:
+      return true;
+  }
+}
+
+}
+
+
 basic_uniform::basic_uniform(untyped_uniform const& u)
-  : _program(u.program())
+  : _program(u.program().name())
+  , _cache(u.program()._uniform_cache.get())
   , _location(u.location())
   {}
 
+basic_uniform::basic_uniform(GLuint program, UniformCache& cache, GLint location)
+  : _program(program)
+  , _cache(&cache)
+  , _location(location)
+  {}
+
 
 GLint basic_uniform::location() const {
   return _location;
 }
 
+bool basic_uniform::changed(void const* data, size_t size) const {
+  return _cache->update(_location, data, size);
+}
+
+void basic_uniform::bypass(GLsizei count) const {
+  _cache->bypass(_location, count);
+}
+
+void basic_uniform::check_type(GLenum expected, GLenum boolean, bool opaque /* = false */) const {
+  GLenum type = _cache->type(_location);
+  GL_ASSERT(!type || type == expected || type == boolean || (opaque && opaque_type(type)),
+    "uniform at location %d of program %u is %s, not %s", _location, _program, to_string(type), to_string(expected));
+}
+
 
 // What is this madness? Well, it's a rather C++y way to provide a bit of type safety
 // and translate to the glUniform1f, -2i, -3ui, etc., function names in a compact cpp file.
@@ -47,36 +127,19 @@ GLint basic_uniform::location() const {
 template<typename... T>
 uniform<T...>::uniform(untyped_uniform const& u)
   : basic_uniform(u)
-  {}
-
-
-// uniform scalar specialization
-#define SPECIALIZE_STEP1(...) template<> void uniform<__VA_ARGS__>
-#define SPECIALIZE_STEP2(...) ::set(__VA_ARGS__)
-#define SPECIALIZE_STEP3(Count, Suffix, ...) { \
-  ProgramBindguard guard(_program->name()); \
-  GL_CALL(glUniform##Count##Suffix(_location, __VA_ARGS__ )); \
+{
+  using U = typename std::tuple_element<0, std::tuple<T...>>::type;
+  check_type(vector_type(U(), sizeof...(T)), bool_type(sizeof...(T)), sizeof...(T) == 1 && std::is_same<U, GLint>::value);
 }
 
-#define SPECIALIZE2(Type, Suffix) \
-  SPECIALIZE_STEP1(Type, Type) \
-  SPECIALIZE_STEP2(Type v0, Type v1) \
-  SPECIALIZE_STEP3(2, Suffix, v0, v1)
-
-#define SPECIALIZE3(Type, Suffix) \
-  SPECIALIZE_STEP1(Type, Type, Type) \
-  SPECIALIZE_STEP2(Type v0, Type v1, Type v2) \
-  SPECIALIZE_STEP3(3, Suffix, v0, v1, v2)
-
-#define SPECIALIZE4(Type, Suffix) \
-  SPECIALIZE_STEP1(Type, Type, Type, Type) \
-  SPECIALIZE_STEP2(Type v0, Type v1, Type v2, Type v3) \
-  SPECIALIZE_STEP3(4, Suffix, v0, v1, v2, v3)
+template<typename... T>
+uniform<T...>::uniform(GLuint program, UniformCache& cache, GLint location)
+  : basic_uniform(program, cache, location)
+{
+  using U = typename std::tuple_element<0, std::tuple<T...>>::type;
+  check_type(vector_type(U(), sizeof...(T)), bool_type(sizeof...(T)), sizeof...(T) == 1 && std::is_same<U, GLint>::value);
+}
 
-#define SPECIALIZE_TYPE(Type, Suffix) \
-  SPECIALIZE2(Type, Suffix) \
-  SPECIALIZE3(Type, Suffix) \
-  SPECIALIZE4(Type, Suffix)
 
 #define INSTANTIATE(...) template class uniform<__VA_ARGS__>;
 #define INSTANTIATE_TYPE(T) \
@@ -90,12 +153,6 @@ INSTANTIATE_TYPE(GLint);
 INSTANTIATE_TYPE(GLuint);
 #undef INSTANTIATE
 #undef INSTANTIATE_TYPE
-#undef SPECIALIZE_STEP1
-#undef SPECIALIZE_STEP2
-#undef SPECIALIZE_STEP3
-#undef SPECIALIZE2
-#undef SPECIALIZE3
-#undef SPECIALIZE4
 
 
 
@@ -104,14 +161,29 @@ template<unsigned N, unsigned M>
 uniform_matrix<N, M>::uniform_matrix(untyped_uniform const& u, GLsizei count)
   : basic_uniform(u)
   , _count(count)
-  {}
+{
+  check_type(matrix_type(N, M));
+}
+
+template<unsigned N, unsigned M>
+uniform_matrix<N, M>::uniform_matrix(GLuint program, UniformCache& cache, GLint location, GLsizei count)
+  : basic_uniform(program, cache, location)
+  , _count(count)
+{
+  check_type(matrix_type(N, M));
+}
 
 
+// A transposed matrix doesn't match the column-major values the cache keeps.
 #define SPECIALIZE_AND_INSTANTIATE(N, M, SUFFIX) \
   template<> \
   void uniform_matrix<N, M>::set(GLfloat const* value, bool transpose) { \
-    ProgramBindguard guard(_program); \
-    GL_CALL(glUniformMatrix##SUFFIX##fv(_location, _count, (GLboolean)transpose, value)); \
+    if (transpose) { \
+      bypass(_count); \
+    } else if (!changed(value, N * M * _count * sizeof(GLfloat))) { \
+      return; \
+    } \
+    GL_CALL(glProgramUniformMatrix##SUFFIX##fv(_program, _location, _count, (GLboolean)transpose, value)); \
   } \
   template class uniform_matrix< N, M >;
 
@@ -123,6 +195,8 @@ SPECIALIZE_AND_INSTANTIATE(2, 3, 2x3);
 SPECIALIZE_AND_INSTANTIATE(3, 2, 3x2);
 SPECIALIZE_AND_INSTANTIATE(2, 4, 2x4);
 SPECIALIZE_AND_INSTANTIATE(4, 2, 4x2);
+SPECIALIZE_AND_INSTANTIATE(3, 4, 3x4);
+SPECIALIZE_AND_INSTANTIATE(4, 3, 4x3);
 
 
 
@@ -138,17 +212,19 @@ SPECIALIZE_AND_INSTANTIATE(4, 2, 4x2);
 
 
 
+// Every set goes through the Program's cache of uniform values, and then
+// glProgramUniform, which needs no glUseProgram.
 #define SPECIALIZE(Type, Suffix) \
-  template<> void uniform2<Type>::set(vec2<Type> const& v) { GL_CALL(glProgramUniform2##Suffix(_program.name(), _location, v.x, v.y)); } \
-  template<> void uniform3<Type>::set(vec3<Type> const& v) { GL_CALL(glProgramUniform3##Suffix(_program.name(), _location, v.x, v.y, v.z)); } \
-  template<> void uniform4<Type>::set(vec4<Type> const& v) { GL_CALL(glProgramUniform4##Suffix(_program.name(), _location, v.x, v.y, v.z, v.w)); } \
-  template<> void uniform<Type>::set(Type v0) { GL_CALL(glProgramUniform1##Suffix(_program.name(), _location, v0)); } \
-  template<> void uniform2<Type>::set(Type v0, Type v1) { GL_CALL(glProgramUniform2##Suffix(_program.name(), _location, v0, v1)); } \
-  template<> void uniform3<Type>::set(Type v0, Type v1, Type v2) { GL_CALL(glProgramUniform3##Suffix(_program.name(), _location, v0, v1, v2)); } \
-  template<> void uniform4<Type>::set(Type v0, Type v1, Type v2, Type v3) { GL_CALL(glProgramUniform4##Suffix(_program.name(), _location, v0, v1, v2, v3)); } \
-  template<> vec2<Type> uniform2<Type>::get() const { Type params[2]; GL_CALL(glGetUniform##Suffix##v(_program.name(), _location, params)); return vec2<Type>(params[0], params[1]); } \
-  template<> vec3<Type> uniform3<Type>::get() const { Type params[3]; GL_CALL(glGetUniform##Suffix##v(_program.name(), _location, params)); return vec3<Type>(params[0], params[1], params[2]); } \
-  template<> vec4<Type> uniform4<Type>::get() const { Type params[4]; GL_CALL(glGetUniform##Suffix##v(_program.name(), _location, params)); return vec4<Type>(params[0], params[1], params[2], params[3]); } \
+  template<> void uniform<Type>::set(Type v0) { if (changed(&v0, sizeof(v0))) { GL_CALL(glProgramUniform1##Suffix(_program, _location, v0)); } } \
+  template<> void uniform2<Type>::set(Type v0, Type v1) { Type v[] = { v0, v1 }; if (changed(v, sizeof(v))) { GL_CALL(glProgramUniform2##Suffix##v(_program, _location, 1, v)); } } \
+  template<> void uniform3<Type>::set(Type v0, Type v1, Type v2) { Type v[] = { v0, v1, v2 }; if (changed(v, sizeof(v))) { GL_CALL(glProgramUniform3##Suffix##v(_program, _location, 1, v)); } } \
+  template<> void uniform4<Type>::set(Type v0, Type v1, Type v2, Type v3) { Type v[] = { v0, v1, v2, v3 }; if (changed(v, sizeof(v))) { GL_CALL(glProgramUniform4##Suffix##v(_program, _location, 1, v)); } } \
+  template<> void uniform2<Type>::set(vec2<Type> const& v) { set(v.x, v.y); } \
+  template<> void uniform3<Type>::set(vec3<Type> const& v) { set(v.x, v.y, v.z); } \
+  template<> void uniform4<Type>::set(vec4<Type> const& v) { set(v.x, v.y, v.z, v.w); } \
+  template<> vec2<Type> uniform2<Type>::get() const { Type params[2]; GL_CALL(glGetUniform##Suffix##v(_program, _location, params)); return vec2<Type>(params[0], params[1]); } \
+  template<> vec3<Type> uniform3<Type>::get() const { Type params[3]; GL_CALL(glGetUniform##Suffix##v(_program, _location, params)); return vec3<Type>(params[0], params[1], params[2]); } \
+  template<> vec4<Type> uniform4<Type>::get() const { Type params[4]; GL_CALL(glGetUniform##Suffix##v(_program, _location, params)); return vec4<Type>(params[0], params[1], params[2], params[3]); } \
 
 
 SPECIALIZE(GLfloat, f);
@@ -169,7 +245,9 @@ void uniform_sampler::set(TextureUnit const& unit) {
 }
 
 void uniform_sampler::set(std::vector<GLint> const& v) {
-  GL_CALL(glProgramUniform1iv(_program.name(), _location, (GLsizei)v.size(), v.data()));
+  if (changed(v.data(), v.size() * sizeof(GLint))) {
+    GL_CALL(glProgramUniform1iv(_program, _location, (GLsizei)v.size(), v.data()));
+  }
 }
 
 
@@ -34,15 +34,43 @@ namespace detail {
 class basic_uniform {
   protected:
     basic_uniform(untyped_uniform const&);
+    basic_uniform(GLuint program, UniformCache& cache, GLint location);
 
   public:
     GLint location() const;
 
   protected:
-    Program const& _program;
+    /**
+     * @brief whether setting `size` bytes at the location would change what
+     * the Program holds, i.e. whether the GL call is needed. See
+     * Program::uniform_stats().
+     **/
+    bool changed(void const* data, size_t size) const;
+
+    /**
+     * @brief a set of `count` locations the cache can't follow.
+     **/
+    void bypass(GLsizei count) const;
+
+    /**
+     * @brief throw gl::exception unless the uniform was reflected as type
+     * `expected` or `boolean`, or, if `opaque`, as a sampler or image. A
+     * location that wasn't reflected isn't checked.
+     **/
+    void check_type(GLenum expected, GLenum boolean = 0, bool opaque = false) const;
+
+  protected:
+    // The Program's name and cache, rather than the Program, which may move.
+    GLuint _program;
+    UniformCache* _cache;
     GLint _location { -1 };
 };
 
+/**
+ * @brief a uniform of 1 to 4 Ts, e.g. uniform4<float> for a vec4 (or bvec4).
+ * Constructing one for a uniform the Program reflected as another type
+ * throws gl::exception.
+ **/
 template<typename... T>
 class uniform : public basic_uniform {
   using vec_t = vec<T...>;
@@ -50,6 +78,12 @@ class uniform : public basic_uniform {
   public:
     uniform(untyped_uniform const&);
 
+    /**
+     * @brief the uniform at `location` of the Program named `program`, whose
+     * cache is `cache`; for CommandBuffer, which records those.
+     **/
+    uniform(GLuint program, UniformCache& cache, GLint location);
+
   public:
     void set(T... values);
     void set(vec_t const& vec);
@@ -63,6 +97,7 @@ class uniform_matrix : public basic_uniform {
   public:
     uniform_matrix();
     uniform_matrix(untyped_uniform const&, GLsizei count = 1);
+    uniform_matrix(GLuint program, UniformCache& cache, GLint location, GLsizei count = 1);
 
   public:
     void set(GLfloat const*, bool transpose = false);
@@ -1,4 +1,8 @@
 #include "uniform_buffer.h"
+#include "state_cache.h"
+#include "capabilities.h"
+
+#include <algorithm>
 
 using namespace gl;
 
@@ -12,5 +16,90 @@ void UniformBuffer::bind(GLuint binding) const {
     binding,
     _buffer.name()
   ));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(GL_UNIFORM_BUFFER, _buffer.name());
+  }
+}
+
+void UniformBuffer::bind(GLuint binding, size_t offset, size_t size) const {
+  detail::bind_buffer_range(GL_UNIFORM_BUFFER, binding, _buffer, offset, size);
 }
 
+
+
+detail::ShadowedBuffer::ShadowedBuffer(size_t size, GLenum usage)
+  : _shadow(size, 0)
+{
+  _buffer.data(_shadow, usage);
+}
+
+
+void detail::ShadowedBuffer::mark(size_t offset, size_t size) {
+  size_t end = std::min(offset + size, _shadow.size());
+  if (!_dirty.empty()) {
+    auto& last = _dirty.back();
+    if (offset >= last.first && offset <= last.second + merge_gap) {
+      // The common case: members written in order.
+      last.second = std::max(last.second, end);
+      return;
+    }
+    _merged = _merged && offset > last.second;
+  }
+  _dirty.emplace_back(offset, end);
+}
+
+std::vector<std::pair<size_t, size_t>> const& detail::ShadowedBuffer::dirty_ranges() {
+  if (!_merged) {
+    std::sort(_dirty.begin(), _dirty.end());
+    size_t out = 0;
+    for (size_t i = 1; i < _dirty.size(); ++i) {
+      if (_dirty[i].first <= _dirty[out].second + merge_gap) {
+        _dirty[out].second = std::max(_dirty[out].second, _dirty[i].second);
+      } else {
+        _dirty[++out] = _dirty[i];
+      }
+    }
+    _dirty.resize(out + 1);
+    _merged = true;
+  }
+  return _dirty;
+}
+
+size_t detail::ShadowedBuffer::flush() {
+  size_t bytes = 0;
+  for (auto const& range : dirty_ranges()) {
+    _buffer.write(range.first, range.second - range.first, _shadow.data() + range.first);
+    bytes += range.second - range.first;
+  }
+  _dirty.clear();
+  _merged = true;
+  return bytes;
+}
+
+void detail::bind_buffer_range(GLenum target, GLuint binding, Buffer const& buffer, size_t offset, size_t size) {
+  if (auto caps = detail::current_capabilities()) {
+    GLuint alignment = 1;
+    switch (target) {
+      case GL_UNIFORM_BUFFER: alignment = caps->uniform_buffer_offset_alignment; break;
+#ifdef GL_VERSION_4_3
+      case GL_SHADER_STORAGE_BUFFER: alignment = caps->shader_storage_buffer_offset_alignment; break;
+#endif
+#ifdef GL_VERSION_4_2
+      case GL_ATOMIC_COUNTER_BUFFER: alignment = 4; break;
+#endif
+    }
+    GL_ASSERT(alignment && offset % alignment == 0, "binding a range at %u, which isn't a multiple of %u", offset, alignment);
+  }
+  GL_ASSERT(offset + size <= buffer.size(), "binding %u bytes at %u of a %u byte buffer", size, offset, buffer.size());
+  GL_CALL(glBindBufferRange(target, binding, buffer.name(), GLintptr(offset), GLsizeiptr(size)));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(target, buffer.name());
+  }
+}
+
+void detail::ShadowedBuffer::bind(GLenum target, GLuint binding) const {
+  GL_CALL(glBindBufferBase(target, binding, _buffer.name()));
+  if (auto state = detail::current_state()) {
+    state->note_buffer(target, _buffer.name());
+  }
+}
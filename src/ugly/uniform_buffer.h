@@ -1,6 +1,7 @@
 #pragma once
 
 #include "buffer.h"
+#include "block_layout.h"
 #include <memory>
 #include <vector>
 #include <array>
@@ -16,6 +17,8 @@ class UniformBuffer {
     ~UniformBuffer();
     UniformBuffer(UniformBuffer const&) = delete;
     UniformBuffer& operator=(UniformBuffer const&) = delete;
+    UniformBuffer(UniformBuffer&&) = default;
+    UniformBuffer& operator=(UniformBuffer&&) = default;
 
   public:
     template<typename T>
@@ -39,12 +42,143 @@ class UniformBuffer {
 
     void bind(GLuint binding) const;
 
+    /**
+     * @brief bind `size` bytes from `offset` to `binding`, with
+     * glBindBufferRange. `offset` must be a multiple of
+     * GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+     **/
+    void bind(GLuint binding, size_t offset, size_t size) const;
+
+    Buffer& buffer() { return _buffer; }
+    Buffer const& buffer() const { return _buffer; }
+
   private:
     Buffer _buffer;
 
 };
 
 
+namespace detail {
+
+/**
+ * @brief glBindBufferRange, checking `offset` against the target's alignment
+ * and the range against the Buffer's size.
+ **/
+void bind_buffer_range(GLenum target, GLuint binding, Buffer const& buffer, size_t offset, size_t size);
+
+/**
+ * @brief a Buffer with a copy of its contents in memory, and the byte ranges
+ * of the copy that have changed since they were last uploaded.
+ **/
+class ShadowedBuffer {
+  public:
+    // Dirty ranges closer than this are uploaded as one: another call costs
+    // more than a few extra bytes.
+    static const size_t merge_gap = 64;
+
+  public:
+    ShadowedBuffer(size_t size, GLenum usage);
+
+  public:
+    char* data() { return _shadow.data(); }
+    char const* data() const { return _shadow.data(); }
+    size_t size() const { return _shadow.size(); }
+
+    void mark(size_t offset, size_t size);
+    bool dirty() const { return !_dirty.empty(); }
+
+    /**
+     * @brief the ranges flush() would upload, sorted and merged.
+     **/
+    std::vector<std::pair<size_t, size_t>> const& dirty_ranges();
+
+    /**
+     * @brief upload the dirty ranges, one Buffer::write each.
+     * @return the number of bytes uploaded.
+     **/
+    size_t flush();
+
+    void bind(GLenum target, GLuint binding) const;
+    Buffer const& buffer() const { return _buffer; }
+
+  private:
+    Buffer _buffer;
+    std::vector<char> _shadow;
+    std::vector<std::pair<size_t, size_t>> _dirty;  // [begin, end)
+    bool _merged { true };
+
+};
+
+}
+
+
+/**
+ * @brief a uniform block laid out by a BlockLayout, written member by member.
+ *
+ * Members are written to a copy in memory; flush() uploads only the ranges
+ * written since the last flush, merged. bind() flushes first.
+ *
+ *   gl::TypedUniformBuffer<Material> material;
+ *   material.set<1>(0.5f);
+ *   material.set<2>(light, 3);  // lights[3]
+ *   material.bind(0);
+ **/
+template<typename Layout>
+class TypedUniformBuffer {
+  public:
+    explicit TypedUniformBuffer(GLenum usage = GL_DYNAMIC_DRAW)
+      : _shadow(Layout::size(), usage)
+      {}
+
+  public:
+    /**
+     * @brief set member I, or element `index` of it if it's an array.
+     **/
+    template<size_t I, typename U>
+    void set(U const& value, size_t index = 0) {
+      set<I>(&value, 1, index);
+    }
+
+    /**
+     * @brief set `count` elements of array member I, from `first` on.
+     **/
+    template<size_t I, typename U>
+    void set(U const* values, size_t count, size_t first = 0) {
+      using F = typename Layout::template field<I>;
+      GL_ASSERT(first + count <= F::count, "setting elements %u to %u of a member with %u", first, first + count, F::count);
+      Layout::template write<I>(_shadow.data(), values, count, first);
+      _shadow.mark(Layout::template offset<I>() + first * F::stride, count * F::stride);
+    }
+
+    template<size_t I, typename U>
+    void set(std::vector<U> const& values, size_t first = 0) {
+      set<I>(values.data(), values.size(), first);
+    }
+
+  public:
+    /**
+     * @brief upload what changed. Returns the number of bytes uploaded.
+     **/
+    size_t flush() { return _shadow.flush(); }
+
+    void bind(GLuint binding) {
+      _shadow.flush();
+      _shadow.bind(GL_UNIFORM_BUFFER, binding);
+    }
+
+    bool dirty() const { return _shadow.dirty(); }
+    std::vector<std::pair<size_t, size_t>> const& dirty_ranges() { return _shadow.dirty_ranges(); }
+
+    Buffer const& buffer() const { return _shadow.buffer(); }
+    void const* data() const { return _shadow.data(); }
+    static constexpr size_t size() { return Layout::size(); }
+
+  private:
+    detail::ShadowedBuffer _shadow;
+
+};
+
+
 
 
 }
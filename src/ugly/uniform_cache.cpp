@@ -0,0 +1,136 @@
+#include "uniform_cache.h"
+
+#include <cstring>
+
+namespace gl {
+namespace detail {
+
+
+namespace {
+
+// Bytes in one value of a uniform of type `type`, as passed to glProgramUniform*.
+size_t uniform_type_size(GLenum type) {
+  switch (type) {
+    case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+      return 2 * 4;
+    case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+      return 3 * 4;
+    case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2:
+      return 4 * 4;
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+      return 6 * 4;
+    case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+      return 8 * 4;
+    case GL_FLOAT_MAT3:
+      return 9 * 4;
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+      return 12 * 4;
+    case GL_FLOAT_MAT4:
+      return 16 * 4;
+    case GL_DOUBLE:
+      return 8;
+    case GL_DOUBLE_VEC2:
+      return 2 * 8;
+    case GL_DOUBLE_VEC3:
+      return 3 * 8;
+    case GL_DOUBLE_VEC4: case GL_DOUBLE_MAT2:
+      return 4 * 8;
+    case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT3x2:
+      return 6 * 8;
+    case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT4x2:
+      return 8 * 8;
+    case GL_DOUBLE_MAT3:
+      return 9 * 8;
+    case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x3:
+      return 12 * 8;
+    case GL_DOUBLE_MAT4:
+      return 16 * 8;
+    default:  // float, int, uint, bool, and samplers and images, set as an int
+      return 4;
+  }
+}
+
+
+}
+
+
+
+void UniformCache::clear() {
+  _slots.clear();
+  _values.clear();
+}
+
+void UniformCache::add(GLint location, GLenum type, GLint previous /* = -1 */) {
+  if (location < 0) {
+    return;
+  }
+  if (size_t(location) >= _slots.size()) {
+    _slots.resize(location + 1);
+  }
+  auto& slot = _slots[location];
+  slot.offset = _values.size();
+  slot.size = uniform_type_size(type);
+  slot.type = type;
+  slot.known = false;
+  _values.resize(_values.size() + slot.size);
+  if (previous >= 0) {
+    _slots[previous].next = location;
+  }
+}
+
+
+bool UniformCache::update(GLint location, void const* data, size_t size) {
+  if (location < 0) {
+    return false;  // not an active uniform: GL would ignore it
+  }
+  auto bytes = static_cast<char const*>(data);
+  bool changed = false;
+  for (GLint l = location; size && l >= 0; ) {  // past the last element, GL ignores the rest
+    if (size_t(l) >= _slots.size() || !_slots[l].size || size < _slots[l].size) {
+      // Not a value the cache can follow: a location it doesn't know, or
+      // part of one (which GL would refuse anyway).
+      if (size_t(l) < _slots.size()) {
+        _slots[l].known = false;
+      }
+      changed = true;
+      break;
+    }
+    auto& slot = _slots[l];
+    char* value = _values.data() + slot.offset;
+    if (!slot.known || std::memcmp(value, bytes, slot.size) != 0) {
+      std::memcpy(value, bytes, slot.size);
+      slot.known = true;
+      changed = true;
+    }
+    bytes += slot.size;
+    size -= slot.size;
+    l = slot.next;
+  }
+  ++(changed ? _stats.issued : _stats.skipped);
+  return changed;
+}
+
+void UniformCache::bypass(GLint location, GLsizei count /* = 1 */) {
+  if (location < 0) {
+    return;
+  }
+  ++_stats.issued;
+  for (GLint l = location; count-- && l >= 0 && size_t(l) < _slots.size(); l = _slots[l].next) {
+    _slots[l].known = false;
+  }
+}
+
+GLenum UniformCache::type(GLint location) const {
+  return location >= 0 && size_t(location) < _slots.size() ? _slots[location].type : 0;
+}
+
+void UniformCache::invalidate() {
+  for (auto& slot : _slots) {
+    slot.known = false;
+  }
+}
+
+
+} // namespace detail
+} // namespace gl
@@ -0,0 +1,85 @@
+#ifndef UGLY_UNIFORM_CACHE_H
+#define UGLY_UNIFORM_CACHE_H
+
+#include "gl_type.h"
+
+#include <vector>
+
+namespace gl {
+
+
+struct UniformStats {
+  uint64_t issued { 0 };
+  uint64_t skipped { 0 };
+};
+
+
+namespace detail {
+
+/**
+ * @brief the last value set at each uniform location of a Program, so that
+ * setting the same value again can skip the GL call.
+ *
+ * Locations are filled in from reflection when the Program links; until a
+ * location has been set once through the cache, its value is unknown and the
+ * first set always goes to GL. Locations the cache doesn't know are never
+ * skipped.
+ **/
+class UniformCache {
+  public:
+    void clear();
+
+    /**
+     * @brief make room for a value of GL type `type` at `location`: one
+     * element, for arrays, the elements after the first following `previous`.
+     **/
+    void add(GLint location, GLenum type, GLint previous = -1);
+
+    /**
+     * @brief the GL type at `location`, or 0 if the cache doesn't know it.
+     **/
+    GLenum type(GLint location) const;
+
+    /**
+     * @brief record `size` bytes of `data` set from `location` on (several
+     * locations' worth, for arrays). Returns false if they're what the
+     * locations already hold, so the GL call can be skipped.
+     **/
+    bool update(GLint location, void const* data, size_t size);
+
+    /**
+     * @brief record a set of `count` locations from `location` on that the
+     * cache can't follow, e.g. a transposed matrix: they're unknown again.
+     **/
+    void bypass(GLint location, GLsizei count = 1);
+
+    /**
+     * @brief forget every value, e.g. after setting uniforms directly.
+     **/
+    void invalidate();
+
+    UniformStats const& stats() const { return _stats; }
+    void reset_stats() { _stats = UniformStats(); }
+
+  private:
+    struct Slot {
+      size_t offset { 0 };  // into _values
+      size_t size { 0 };    // 0 for locations that aren't reflected
+      GLint next { -1 };    // of the next array element
+      GLenum type { 0 };
+      bool known { false };
+    };
+
+  private:
+    std::vector<Slot> _slots;  // by location
+    std::vector<char> _values;
+    UniformStats _stats;
+
+};
+
+}
+
+
+} // namespace gl
+
+#endif
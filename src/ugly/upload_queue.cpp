@@ -0,0 +1,143 @@
+#include "upload_queue.h"
+#include "context.h"
+#include "sync.h"
+
+#include <future>
+
+namespace gl {
+
+
+UploadQueue::UploadQueue(ContextFactory factory) {
+  std::promise<void> started;
+  auto result = started.get_future();
+
+  _worker = std::thread([this, &started, factory]() {
+    std::unique_ptr<Context> context;
+    try {
+      context = factory();
+      if (!context) {
+        throw gl::exception("UploadQueue factory returned no context");
+      }
+      context->make_current();
+    } catch (...) {
+      started.set_exception(std::current_exception());
+      return;
+    }
+    started.set_value();
+    run(*context);
+  });
+
+  try {
+    result.get();
+  } catch (...) {
+    _worker.join();
+    throw;
+  }
+}
+
+UploadQueue::~UploadQueue() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_one();
+  _worker.join();
+}
+
+
+void UploadQueue::submit(Job upload, Job ready /* = Job() */) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.emplace_back(std::move(upload), std::move(ready));
+    ++_pending;
+  }
+  _wake.notify_one();
+}
+
+size_t UploadQueue::poll() {
+  std::deque<Done> done;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // The worker's fences signal in the order it inserted them.
+    while (!_done.empty() && _done.front().fence.signaled()) {
+      done.push_back(std::move(_done.front()));
+      _done.pop_front();
+    }
+    _pending -= done.size();
+  }
+  return complete(done);
+}
+
+size_t UploadQueue::finish() {
+  std::deque<Done> done;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _completed.wait(lock, [this]() { return _done.size() == _pending; });
+    done.swap(_done);
+    _pending -= done.size();
+  }
+  for (auto const& d : done) {
+    d.fence.wait();
+  }
+  return complete(done);
+}
+
+size_t UploadQueue::complete(std::deque<Done>& done) {
+  std::exception_ptr error;
+  for (auto& d : done) {
+    if (d.error) {
+      if (!error) {
+        error = d.error;
+      }
+    } else if (d.ready) {
+      d.ready();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return done.size();
+}
+
+size_t UploadQueue::pending() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending;
+}
+
+
+void UploadQueue::run(Context& context) {
+  for (;;) {
+    std::pair<Job, Job> job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+      if (_stop) {
+        return;
+      }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+
+    Done done { std::move(job.second), Sync(nullptr), nullptr };
+    try {
+      job.first();
+      // Objects the render thread destroyed, and the job's own temporaries.
+      context.flush_deletions();
+      // poll() tests the fence from the render thread, which can't flush
+      // this Context for it.
+      done.fence.reset();
+      GL_CALL(glFlush());
+    } catch (...) {
+      done.error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done.push_back(std::move(done));
+    }
+    _completed.notify_all();
+  }
+}
+
+
+} // namespace gl
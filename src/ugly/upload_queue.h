@@ -0,0 +1,112 @@
+#ifndef UGLY_UPLOAD_QUEUE_H
+#define UGLY_UPLOAD_QUEUE_H
+
+#include "gl_type.h"
+#include "sync.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace gl {
+
+
+class Context;
+
+
+/**
+ * @brief runs uploads (Buffer::data, Texture2D::image...) on a worker thread
+ * with its own Context, so they don't stall the render thread.
+ *
+ * The worker Context comes from `factory`, which is called on the worker
+ * thread and must return a Context sharing objects with the render Context,
+ * e.g. a MultiContext around a hidden shared window, or a glx::HeadlessContext
+ * given the render context as `share`.
+ *
+ * Create objects wherever is convenient and fill them in a job. Once the
+ * worker's fence for a job has signaled, the job's `ready` callback runs on
+ * the render thread, in a later poll(); only then may the render Context use
+ * what the job uploaded. The worker moves on to the next job without waiting
+ * for the fence. Objects must outlive their job.
+ *
+ * The render Context's cached bindings are left alone. GL only promises that
+ * another Context's changes show once an object is bound again, so a `ready`
+ * callback that needs that guarantee for something already bound should call
+ * Context::invalidate_state().
+ **/
+class UploadQueue {
+  public:
+    using ContextFactory = std::function<std::unique_ptr<Context>()>;
+    using Job = std::function<void()>;
+
+  public:
+    /**
+     * @brief start the worker and wait for its Context. Exceptions thrown by
+     * `factory` are rethrown here.
+     **/
+    explicit UploadQueue(ContextFactory factory);
+
+    /**
+     * @brief stop the worker, discarding jobs it hasn't started.
+     **/
+    ~UploadQueue();
+
+    UploadQueue(UploadQueue const&) = delete;
+    UploadQueue& operator=(UploadQueue const&) = delete;
+
+  public:
+    /**
+     * @brief queue `upload` to run on the worker, then `ready` to run on the
+     * thread calling poll() once the upload has completed on the GPU.
+     **/
+    void submit(Job upload, Job ready = Job());
+
+    /**
+     * @brief run the `ready` callbacks of completed jobs on the calling
+     * thread, which should be the render thread with its Context current.
+     * Rethrows the exception of a failed upload. Returns the number of jobs
+     * completed.
+     **/
+    size_t poll();
+
+    /**
+     * @brief block until every submitted job has completed, then hand them
+     * all back like poll().
+     **/
+    size_t finish();
+
+    /**
+     * @brief the number of jobs submitted but not yet handed back by poll().
+     **/
+    size_t pending() const;
+
+  private:
+    struct Done {
+      Job ready;
+      Sync fence;
+      std::exception_ptr error;
+    };
+
+    size_t complete(std::deque<Done>& done);
+    void run(Context& context);
+
+  private:
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _completed;
+    std::deque<std::pair<Job, Job>> _jobs;
+    std::deque<Done> _done;
+    size_t _pending { 0 };
+    bool _stop { false };
+    std::thread _worker;
+
+};
+
+
+} // namespace gl
+
+#endif
@@ -21,6 +21,10 @@ void VertexArray::pointer(Buffer const& buffer, attrib const& attrib, GLint size
   GL_CALL(glVertexAttribPointer(attrib.location(), size, type, normalized, stride, (void const*)offset));
 }
 
+void VertexArray::pointer(BufferSlice const& slice, attrib const& attrib, GLint size, GLenum type, bool normalized, GLsizei stride, size_t offset /* = 0 */) {
+  pointer(*slice.buffer, attrib, size, type, normalized, stride, slice.offset + offset);
+}
+
 void VertexArray::enable(attrib const& attrib) {
   VertexArrayBindguard guard(*this);
   GL_CALL(glEnableVertexAttribArray(attrib.location()));
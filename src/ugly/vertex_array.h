@@ -11,6 +11,7 @@ namespace gl {
 
 
 class Buffer;
+struct BufferSlice;
 class Framebuffer;
 class attrib;
 
@@ -27,6 +28,11 @@ class VertexArray : public GeneratedObject<glGenVertexArrays, glDeleteVertexArra
   public:
     void pointer(Buffer const& buffer, attrib const& attrib, GLint size, GLenum type, bool normalized, GLsizei stride, size_t offset);
 
+    /**
+     * @brief point at data in a slice; `offset` is from the start of the slice.
+     **/
+    void pointer(BufferSlice const& slice, attrib const& attrib, GLint size, GLenum type, bool normalized, GLsizei stride, size_t offset = 0);
+
   public: // Optionally store count and mode params for use with drawing.
     GLsizei count() const;
     void set_count(GLsizei);
@@ -0,0 +1,152 @@
+#include "log.h"
+#include "ugly.h"
+
+#ifdef UGLY_HEADLESS
+#include "ugly-ext/headless_context.h"
+#else
+#include "glfw_app.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+// Measures recording 50k draws, each with a uniform update, split across 1..8
+// threads that each fill their own CommandBuffer, and then replaying them on
+// the Context's thread. Recording never touches shared state, so its wall
+// time should drop close to linearly with the thread count, up to the number
+// of cores. Every frame reset()s the buffers first, so after the first frame
+// recording reuses the memory it already owns. Build with -DUGLY_HEADLESS to
+// run without a display.
+
+
+namespace {
+
+using bench_clock = std::chrono::high_resolution_clock;
+using ms = std::chrono::duration<double, std::milli>;
+
+const size_t draws = 50000;
+const size_t frames = 20;
+
+
+struct Scene {
+  gl::Program const& program;
+  gl::VertexArray const& vao;
+  GLint color;
+};
+
+
+void record(Scene const& scene, gl::CommandBuffer& commands, size_t first, size_t count) {
+  for (size_t i = first; i < first + count; ++i) {
+    commands.uniform(scene.program, scene.color, float(i & 1), 0.f, 0.f, 1.f);
+    commands.draw(scene.program, scene.vao, GL_TRIANGLE_STRIP, 4);
+  }
+}
+
+
+void run(gl::Context& context, Scene const& scene, size_t thread_count, double& single_thread_ms) {
+  std::vector<gl::CommandBuffer> buffers (thread_count);
+  double best_record_ms = 0;
+  double best_replay_ms = 0;
+
+  for (size_t frame = 0; frame < frames; ++frame) {
+    for (auto& commands : buffers) {
+      commands.reset();
+    }
+
+    std::atomic<size_t> ready { 0 };
+    std::atomic<bool> go { false };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&, i]() {
+        size_t first = draws * i / thread_count;
+        size_t last = draws * (i + 1) / thread_count;
+        ++ready;
+        while (!go) {
+          std::this_thread::yield();
+        }
+        record(scene, buffers[i], first, last - first);
+      });
+    }
+    while (ready != thread_count) {
+      std::this_thread::yield();
+    }
+
+    auto start = bench_clock::now();
+    go = true;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto recorded = bench_clock::now();
+
+    for (auto const& commands : buffers) {
+      context.execute(commands);
+    }
+    glFinish();
+    auto replayed = bench_clock::now();
+    context.end_frame();
+
+    auto record_ms = ms(recorded - start).count();
+    auto replay_ms = ms(replayed - recorded).count();
+    if (frame == 0 || record_ms < best_record_ms) {
+      best_record_ms = record_ms;
+    }
+    if (frame == 0 || replay_ms < best_replay_ms) {
+      best_replay_ms = replay_ms;
+    }
+  }
+
+  if (thread_count == 1) {
+    single_thread_ms = best_record_ms;
+  }
+  logi("%zu threads: record %.2f ms (%.2fx), replay %.2f ms, for %zu draws",
+    thread_count, best_record_ms, single_thread_ms / best_record_ms, best_replay_ms, draws);
+}
+
+}
+
+
+int main(int argc, const char* const argv[]) {
+  const size_t max_threads = 8;
+
+  try {
+#ifdef UGLY_HEADLESS
+    glx::HeadlessContext context;
+#else
+    glfwApp app;
+    gl::MonoContext context (&app);
+#endif
+    context.binding_policy(gl::BINDING_LEAVE_BOUND);
+
+    gl::Program program (
+      gl::VertexShader("shaders/vert.glsl"),
+      gl::FragmentShader("shaders/frag.glsl")
+    );
+
+    gl::Buffer vbo;
+    vbo.data(std::vector<GLfloat>({
+      -1.f, -1.f,
+      +1.f, -1.f,
+      -1.f, +1.f,
+      +1.f, +1.f,
+    }), GL_STATIC_DRAW);
+
+    gl::attrib position (program.attrib_location("position"));
+    gl::VertexArray vao (GL_TRIANGLE_STRIP);
+    vao.pointer(vbo, position, 2, GL_FLOAT, false, 0, 0);
+    vao.enable(position);
+
+    Scene scene { program, vao, program.uniform_location("color") };
+    logi("%u hardware threads", std::thread::hardware_concurrency());
+
+    double single_thread_ms = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      run(context, scene, threads, single_thread_ms);
+    }
+
+  } catch(gl::exception const& e) {
+    loge("caught exception: %s", e.what());
+  }
+}
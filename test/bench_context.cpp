@@ -0,0 +1,138 @@
+#include "log.h"
+#include "ugly.h"
+
+#include "glfw_app.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Measures MultiContext::make_current() and current() with 1..8 threads, each
+// driving its own MultiContexts. The per-call cost should stay flat as threads
+// are added, since neither call touches any shared state.
+//
+// make_current on a Context that's already current returns early, so each
+// thread also switches back and forth between two Contexts: once with no
+// OS_Bridge, which times the library's own bookkeeping, and once making the
+// GLFW context current as well, which adds the driver's switch.
+
+
+namespace {
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+const size_t iterations = 10000000;
+const size_t driver_iterations = 10000;
+
+struct Result {
+  double make_current_ns;
+  double current_ns;
+  double switch_ns;
+  double driver_switch_ns;
+};
+
+
+Result run_thread(glfwApp& app, glfwApp& other_app, std::atomic<bool>& go) {
+  gl::OS_Bridge bridge { [](void* window) { static_cast<glfwApp*>(window)->make_current(); } };
+  app.make_current();
+  gl::MultiContext context (&app);
+  gl::MultiContext bridged (&app, bridge);
+  other_app.make_current();
+  gl::MultiContext other (&other_app);
+  gl::MultiContext other_bridged (&other_app, bridge);
+  context.make_current();
+
+  while (!go) {
+    std::this_thread::yield();
+  }
+
+  auto start = bench_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    context.make_current();
+  }
+  auto middle = bench_clock::now();
+
+  size_t current = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    current += context.current();
+  }
+  auto end = bench_clock::now();
+
+  if (current != iterations) {
+    loge("context was not current for every iteration");
+  }
+
+  auto switch_start = bench_clock::now();
+  for (size_t i = 0; i < iterations / 2; ++i) {
+    other.make_current();
+    context.make_current();
+  }
+  auto switch_end = bench_clock::now();
+
+  for (size_t i = 0; i < driver_iterations / 2; ++i) {
+    other_bridged.make_current();
+    bridged.make_current();
+  }
+  auto driver_end = bench_clock::now();
+
+  using ns = std::chrono::duration<double, std::nano>;
+  return {
+    ns(middle - start).count() / iterations,
+    ns(end - middle).count() / iterations,
+    ns(switch_end - switch_start).count() / iterations,
+    ns(driver_end - switch_end).count() / driver_iterations,
+  };
+}
+
+
+void run(std::vector<std::unique_ptr<glfwApp>>& apps, size_t thread_count) {
+  std::atomic<bool> go { false };
+  std::vector<Result> results (thread_count);
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back([&, i]() {
+      results[i] = run_thread(*apps[2 * i], *apps[2 * i + 1], go);
+    });
+  }
+  go = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  Result mean { 0, 0, 0, 0 };
+  for (auto const& result : results) {
+    mean.make_current_ns += result.make_current_ns / thread_count;
+    mean.current_ns += result.current_ns / thread_count;
+    mean.switch_ns += result.switch_ns / thread_count;
+    mean.driver_switch_ns += result.driver_switch_ns / thread_count;
+  }
+  logi("%zu threads: make_current %.2f ns/call, current %.2f ns/call, switch %.2f ns/call, switch with driver %.2f ns/call",
+    thread_count, mean.make_current_ns, mean.current_ns, mean.switch_ns, mean.driver_switch_ns);
+}
+
+}
+
+
+int main(int argc, const char* const argv[]) {
+  const size_t max_threads = 8;
+
+  try {
+    // GLFW windows have to be created on the main thread; two per thread.
+    std::vector<std::unique_ptr<glfwApp>> apps;
+    for (size_t i = 0; i < 2 * max_threads; ++i) {
+      apps.emplace_back(new glfwApp);
+    }
+    glfwMakeContextCurrent(nullptr);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      run(apps, threads);
+    }
+
+  } catch(gl::exception const& e) {
+    loge("caught exception: %s", e.what());
+  }
+}
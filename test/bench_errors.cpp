@@ -0,0 +1,115 @@
+#include "log.h"
+#include "ugly.h"
+
+#ifdef UGLY_HEADLESS
+#include "ugly-ext/headless_context.h"
+#else
+#include "glfw_app.h"
+#endif
+
+#include <chrono>
+#include <vector>
+
+
+// Measures the per-call cost of each ErrorPolicy for uniform updates and draws.
+// Under CHECKED every call is followed by glGetError; the other policies should
+// cost the same as the bare call. Build with -DNDEBUG (or -DUGLY_ERROR_CHECKS=0)
+// to compare against the checks compiled out entirely, and with -DUGLY_HEADLESS
+// to run without a display.
+
+
+namespace {
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+const size_t uniform_iterations = 1000000;
+const size_t draw_iterations = 100000;
+
+
+const char* policy_name(gl::ErrorPolicy policy) {
+  switch (policy) {
+    case gl::ERROR_POLICY_CHECKED: return "checked";
+    case gl::ERROR_POLICY_DEBUG_CALLBACK: return "debug callback";
+    case gl::ERROR_POLICY_PER_FRAME: return "per frame";
+    case gl::ERROR_POLICY_OFF: return "off";
+  }
+  return "?";
+}
+
+
+template<typename F>
+double time_ns(size_t iterations, F f) {
+  auto start = bench_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    f(i);
+  }
+  auto end = bench_clock::now();
+  using ns = std::chrono::duration<double, std::nano>;
+  return ns(end - start).count() / iterations;
+}
+
+}
+
+
+int main(int argc, const char* const argv[]) {
+  try {
+#ifdef UGLY_HEADLESS
+    glx::HeadlessContext context;
+#else
+    glfwApp app;
+    gl::MonoContext context (&app);
+#endif
+    context.binding_policy(gl::BINDING_LEAVE_BOUND);
+
+    gl::Program program (
+      gl::VertexShader("shaders/vert.glsl"),
+      gl::FragmentShader("shaders/frag.glsl")
+    );
+    gl::uniform4<float> color (program.uniform("color"));
+
+    gl::Buffer vbo;
+    vbo.data(std::vector<GLfloat>({
+      -1.f, -1.f,
+      +1.f, -1.f,
+      -1.f, +1.f,
+      +1.f, +1.f,
+    }), GL_STATIC_DRAW);
+
+    gl::attrib position (program.attrib_location("position"));
+    gl::VertexArray vao (GL_TRIANGLE_STRIP);
+    vao.pointer(vbo, position, 2, GL_FLOAT, false, 0, 0);
+    vao.enable(position);
+
+    const gl::ErrorPolicy policies[] = {
+      gl::ERROR_POLICY_CHECKED,
+      gl::ERROR_POLICY_DEBUG_CALLBACK,
+      gl::ERROR_POLICY_PER_FRAME,
+      gl::ERROR_POLICY_OFF,
+    };
+
+    for (auto policy : policies) {
+      try {
+        context.error_policy(policy);
+      } catch (gl::exception const& e) {
+        logw("skipping %s: %s", policy_name(policy), e.what());
+        continue;
+      }
+
+      auto uniform_ns = time_ns(uniform_iterations, [&](size_t i) {
+        color.set(float(i & 1), 0.f, 0.f, 1.f);
+      });
+      context.end_frame();
+
+      auto draw_ns = time_ns(draw_iterations, [&](size_t) {
+        context.draw(program, vao, GL_TRIANGLE_STRIP, 4);
+      });
+      context.end_frame();
+
+      logi("%-14s uniform %.1f ns/call, draw %.1f ns/call (checks %s)", policy_name(policy),
+        uniform_ns, draw_ns, UGLY_ERROR_CHECKS ? "compiled in" : "compiled out");
+    }
+
+  } catch(gl::exception const& e) {
+    loge("caught exception: %s", e.what());
+  }
+}
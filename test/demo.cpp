@@ -454,6 +454,7 @@ int main(int argc, const char* const argv[]) {
       context.clear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
       blur_sampler[1].set(blur_unit[1]);
       context.draw(blur_program[1], blur_vao[1], GL_TRIANGLE_STRIP, 4, 0);
+      context.end_frame();
       app.update();
     }
 
@@ -35,6 +35,20 @@ glfwApp::glfwApp(int major, int minor) {
   glfwSetKeyCallback(_window, key_callback);
 }
 
+glfwApp::glfwApp(glfwApp const& share, int major, int minor) {
+  ++_refs;
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, true);
+  glfwWindowHint(GLFW_VISIBLE, false);
+
+  _window = glfwCreateWindow(width(), height(), "libugly worker", NULL, share._window);
+
+  glfwWindowHint(GLFW_VISIBLE, true);
+}
+
 glfwApp::~glfwApp() {
   glfwDestroyWindow(_window);
   --_refs;
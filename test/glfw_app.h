@@ -16,6 +16,10 @@ class glfwApp {
 
   public:
     glfwApp(int major = 4, int minor = 1);
+
+    // A hidden window sharing objects with `share`, for a worker Context. The
+    // calling thread's current context is left alone.
+    glfwApp(glfwApp const& share, int major = 4, int minor = 1);
     ~glfwApp();
 
   public:
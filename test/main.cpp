@@ -2,6 +2,9 @@
 #include "ugly.h"
 
 #include "glfw_app.h"
+#ifdef UGLY_HEADLESS
+#include "ugly-ext/headless_context.h"
+#endif
 
 #include <iostream>
 #include <thread>
@@ -104,6 +107,10 @@ void test_enable_disable(gl::Context& context) {
 
 #undef FTUPLE
 
+  // every cached answer below is cross-checked with glIsEnabled
+  auto verify = context.verify_state();
+  context.verify_state(true);
+
   for (auto const& t : funcs) {
     auto name = std::get<0>(t);
     auto enable = std::get<1>(t);
@@ -126,9 +133,13 @@ void test_enable_disable(gl::Context& context) {
     }
   }
 
+  context.enable<GL_BLEND>();
+  glDisable(GL_BLEND);
+  EXPECT_THROW("verification catches a raw glDisable", context.is_enabled<GL_BLEND>());
+  context.invalidate_state();
+  expect("after invalidate_state, the driver is asked again", !context.is_enabled<GL_BLEND>());
 
-
-
+  context.verify_state(verify);
 }
 
 
@@ -348,6 +359,1016 @@ void test_enum_gets(gl::Context const& context) {
 
 
 
+void test_binding_policy(gl::Context& context) {
+  gl::Buffer buffer;
+  auto policy = context.binding_policy();
+
+  context.binding_policy(gl::BINDING_LEAVE_BOUND);
+  buffer.data(16, GL_STATIC_DRAW);
+  context.reset_binding_stats();
+  buffer.data(16, GL_STATIC_DRAW);
+  expect("with BINDING_LEAVE_BOUND, rebinding the same buffer is elided", context.binding_stats().issued, 0u);
+  expect("elided bind is counted", context.binding_stats().elided, 1u);
+
+  context.binding_policy(gl::BINDING_RESTORE_PREVIOUS);
+  buffer.data(16, GL_STATIC_DRAW);
+  expect("with BINDING_RESTORE_PREVIOUS, buffer is still bound afterwards",
+    context.get<GLenum, GL_COPY_WRITE_BUFFER_BINDING>(), buffer.name());
+
+  context.binding_policy(gl::BINDING_UNBIND);
+  buffer.data(16, GL_STATIC_DRAW);
+  expect("with BINDING_UNBIND, nothing is bound afterwards",
+    context.get<GLenum, GL_COPY_WRITE_BUFFER_BINDING>(), 0u);
+
+  context.binding_policy(gl::BINDING_LEAVE_BOUND);
+  gl::VertexArray vao;
+  { gl::VertexArrayBindguard guard (vao); }
+  gl::Buffer indices;
+  indices.data(std::vector<GLuint>({ 0, 1, 2 }), GL_STATIC_DRAW, GL_ELEMENT_ARRAY_BUFFER);
+  glBindVertexArray(vao.name());
+  expect("a vertex array left bound doesn't capture an element array bind",
+    context.get<GLenum, GL_ELEMENT_ARRAY_BUFFER_BINDING>(), 0u);
+  {
+    gl::VertexArrayBindguard guard (vao);
+    gl::BufferBindguard element_guard (GL_ELEMENT_ARRAY_BUFFER, indices);
+  }
+  expect("a vertex array being set up keeps its element array",
+    context.get<GLenum, GL_ELEMENT_ARRAY_BUFFER_BINDING>(), indices.name());
+  glBindVertexArray(0);
+  context.invalidate_state();
+
+  context.binding_policy(gl::BINDING_RESTORE_PREVIOUS);
+  gl::Texture2D texture;
+  glActiveTexture(GL_TEXTURE0 + 3);
+  context.invalidate_state();
+  texture.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  expect("with BINDING_RESTORE_PREVIOUS, editing a texture keeps the active unit",
+    context.get<GLenum, GL_ACTIVE_TEXTURE>(), GLenum(GL_TEXTURE0 + 3));
+  glActiveTexture(GL_TEXTURE0);
+  context.invalidate_state();
+
+  context.binding_policy(policy);
+}
+
+
+void test_render_state(gl::Context& context) {
+  auto const opaque = gl::RenderState().enable(GL_DEPTH_TEST).depth_func(GL_LEQUAL).enable(GL_CULL_FACE);
+  auto const glass = opaque.enable(GL_BLEND).blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).depth_mask(false);
+
+  expect("states built the same way are equal", opaque == gl::RenderState().enable(GL_CULL_FACE).depth_func(GL_LEQUAL).enable(GL_DEPTH_TEST));
+  expect("equal states hash the same", std::hash<gl::RenderState>()(opaque), std::hash<gl::RenderState>()(
+    gl::RenderState().enable(GL_CULL_FACE).depth_func(GL_LEQUAL).enable(GL_DEPTH_TEST)));
+  expect("setters return a copy", !opaque.is_enabled(GL_BLEND));
+  EXPECT_THROW("untracked capability throws", gl::RenderState().enable(GL_TEXTURE_2D));
+  EXPECT_THROW("bad blend factor throws", gl::RenderState().blend_func(GL_LESS, GL_ONE));
+  expect("packed parameters read back", opaque.depth_func() == GLenum(GL_LEQUAL) && opaque.cull_face() == GLenum(GL_BACK)
+    && opaque.front_face() == GLenum(GL_CCW) && opaque.depth_mask());
+
+  context.apply(opaque);
+  expect("depth test enabled", context.get<bool, GL_DEPTH_TEST>());
+  expect("depth func set", context.get<GLenum, GL_DEPTH_FUNC>(), GLenum(GL_LEQUAL));
+
+  context.apply(glass);
+  expect("blend enabled", context.get<bool, GL_BLEND>());
+  expect("blend func set", context.get<GLenum, GL_BLEND_SRC_RGB>(), GLenum(GL_SRC_ALPHA));
+  expect("depth mask off", !context.get<bool, GL_DEPTH_WRITEMASK>());
+  expect("unchanged capability left alone", context.get<bool, GL_CULL_FACE>());
+
+  context.disable<GL_CULL_FACE>();
+  context.apply(glass);
+  expect("apply sees enable/disable made in between", context.get<bool, GL_CULL_FACE>());
+
+  context.apply(glass.stencil_op(GL_KEEP, GL_KEEP, GL_INCR_WRAP).stencil_func(GL_EQUAL, 3, 0xff).color_mask(true, false, true, true));
+  expect("stencil op set", context.get<GLenum, GL_STENCIL_PASS_DEPTH_PASS>(), GLenum(GL_INCR_WRAP));
+  expect("stencil func set", context.get<GLenum, GL_STENCIL_FUNC>(), GLenum(GL_EQUAL));
+  expect("stencil value mask set", context.get<GLint, GL_STENCIL_VALUE_MASK>(), GLint(0xff));
+
+  context.apply(gl::RenderState());
+  expect("back to defaults", !context.get<bool, GL_BLEND>() && context.get<bool, GL_DEPTH_WRITEMASK>());
+}
+
+
+void test_error_policy(gl::Context& context) {
+  auto policy = context.error_policy();
+  bool threw;
+
+#if UGLY_ERROR_CHECKS
+  context.error_policy(gl::ERROR_POLICY_CHECKED);
+  EXPECT_THROW("checked: a failing call throws", GL_CALL(glEnable(GL_NONE)));
+#endif
+
+  context.error_policy(gl::ERROR_POLICY_PER_FRAME);
+  threw = false;
+  try { GL_CALL(glEnable(GL_NONE)); } catch (...) { threw = true; }
+  expect("per frame: a failing call doesn't throw", !threw);
+  EXPECT_THROW("per frame: end_frame throws", context.end_frame());
+  threw = false;
+  try { context.end_frame(); } catch (...) { threw = true; }
+  expect("per frame: the error is cleared once reported", !threw);
+
+  context.error_policy(gl::ERROR_POLICY_OFF);
+  threw = false;
+  try { GL_CALL(glEnable(GL_NONE)); context.end_frame(); } catch (...) { threw = true; }
+  expect("off: nothing throws", !threw);
+  glGetError();
+
+  context.error_policy(policy);
+}
+
+
+void test_command_buffer(gl::Context& context) {
+  gl::Buffer buffer;
+  buffer.data(std::vector<GLint>({ 0, 0, 0, 0 }), GL_DYNAMIC_DRAW);
+
+  gl::CommandBuffer commands;
+  std::thread recorder ([&]() {
+    commands.upload(buffer, std::vector<GLint>({ 1, 2 }), 2 * sizeof(GLint));
+    commands.apply(gl::RenderState().enable(GL_BLEND));
+    commands.clear(GL_COLOR_BUFFER_BIT, gl::color(0.f, 0.f, 0.f, 1.f));
+  });
+  recorder.join();
+  expect("recorded commands", commands.size(), size_t(3));
+
+  context.execute(commands);
+  GLint values[4];
+  buffer.get(0, sizeof(values), values);
+  expect("upload replayed", values[0] == 0 && values[2] == 1 && values[3] == 2);
+  expect("render state replayed", context.get<bool, GL_BLEND>());
+
+  commands.reset();
+  expect("reset empties the buffer", commands.empty());
+  context.apply(gl::RenderState());
+
+  gl::Buffer quad;
+  quad.data(std::vector<GLfloat>({ -1.f, -1.f, +1.f, -1.f, -1.f, +1.f, +1.f, +1.f }), GL_STATIC_DRAW);
+  gl::Program program (
+    gl::VertexShader("shaders/vert.glsl"),
+    gl::FragmentShader("shaders/frag.glsl")
+  );
+  gl::attrib position (program.attrib_location("position"));
+  gl::VertexArray vao (GL_TRIANGLE_STRIP);
+  vao.set_count(4);
+  vao.pointer(quad, position, 2, GL_FLOAT, false, 0, 0);
+  vao.enable(position);
+
+  gl::Renderbuffer target (GL_RGBA8, 4, 4);
+  gl::Framebuffer framebuffer;
+  framebuffer.renderbuffer(GL_COLOR_ATTACHMENT0, target);
+  framebuffer.viewport(0, 0, 4, 4);
+  expect("command target is complete", framebuffer.is_complete());
+
+  // the texture is unbound and samples as opaque black, so the quad draws black
+  const GLfloat identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+  const size_t draws = 100;
+  std::thread draw_recorder ([&]() {
+    commands.framebuffer(framebuffer);
+    commands.clear(GL_COLOR_BUFFER_BIT, gl::color(1.f, 0.f, 0.f, 1.f));
+    commands.uniform_matrix4(program, program.uniform_location("projection"), identity);
+    commands.uniform_matrix4(program, program.uniform_location("modelview"), identity);
+    commands.uniform(program, program.uniform_location("color"), 1.f, 1.f, 1.f, 1.f);
+    for (size_t i = 0; i < draws; ++i) {
+      commands.draw(program, vao);
+    }
+    commands.draw_instanced(program, vao, 3, GL_TRIANGLE_STRIP, 4);
+  });
+  draw_recorder.join();
+  expect("recorded draws", commands.size(), draws + 6);
+
+  GLuint primitives;
+  glGenQueries(1, &primitives);
+  context.invalidate_state();
+  context.reset_binding_stats();
+  glBeginQuery(GL_PRIMITIVES_GENERATED, primitives);
+  context.execute(commands);
+  glEndQuery(GL_PRIMITIVES_GENERATED);
+  GLuint generated = 0;
+  glGetQueryObjectuiv(primitives, GL_QUERY_RESULT, &generated);
+  glDeleteQueries(1, &primitives);
+  expect("every recorded draw is issued", generated, GLuint(2 * draws + 2 * 3));
+
+  // the framebuffer, viewport, program and vertex array are bound once each
+  auto const& stats = context.binding_stats();
+  expect("replay binds each object once", stats.issued, uint64_t(4));
+  expect("repeated draw bindings are elided", stats.elided, uint64_t(1 + 4 * draws));
+
+  GLubyte pixel[4] = { 0, 0, 0, 0 };
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.name());
+  glReadPixels(2, 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  context.invalidate_state();
+  expect("recorded draws cover the clear", pixel[0] == 0 && pixel[3] == 255);
+}
+
+
+void test_sync(gl::Context& context) {
+  gl::Sync fence;
+  expect("fence is set", !fence.empty());
+  expect("wait returns once signaled", fence.wait());
+  expect("signaled after wait", fence.signaled());
+
+  gl::Sync moved (std::move(fence));
+  expect("moved-from sync is empty", fence.empty() && fence.signaled());
+  expect("moved-to sync keeps the fence", !moved.empty() && moved.signaled());
+
+  moved.reset();
+  moved.server_wait();
+  expect("reset fence signals", moved.wait());
+}
+
+
+void test_map_range(gl::Context& context) {
+  gl::Buffer buffer;
+  buffer.data(std::vector<GLint>(64, 0), GL_DYNAMIC_DRAW, GL_ARRAY_BUFFER);
+
+  auto window = buffer.map_range<GLint>(16, 4, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+  expect("buffer is mapped", buffer.mapped());
+  window[1] = 5;
+  window[2] = 6;
+  buffer.flush_mapped_range(sizeof(GLint), 2 * sizeof(GLint));
+  EXPECT_THROW("flushing past the mapped range throws", buffer.flush_mapped_range(2 * sizeof(GLint), 3 * sizeof(GLint)));
+  EXPECT_THROW("mapping twice throws", buffer.map_range(0, 4, GL_MAP_READ_BIT));
+  expect("unmap succeeds", buffer.unmap());
+  expect("buffer is unmapped", !buffer.mapped());
+
+  GLint values[2];
+  buffer.get(17 * sizeof(GLint), sizeof(values), values);
+  expect("flushed range was written", values[0] == 5 && values[1] == 6);
+
+  auto whole = static_cast<GLint const*>(buffer.map(GL_UNIFORM_BUFFER, GL_READ_ONLY));
+  expect("whole map on another target sees the data", whole[18], 6);
+  expect("unmap after a legacy map", buffer.unmap());
+
+  EXPECT_THROW("mapping past the end throws", buffer.map_range(0, 65 * sizeof(GLint), GL_MAP_READ_BIT));
+  EXPECT_THROW("flushing an unmapped buffer throws", buffer.flush_mapped_range(0, 4));
+}
+
+
+void test_read_async(gl::Context& context) {
+  std::vector<GLint> values (256);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = GLint(i);
+  }
+  gl::Buffer buffer;
+  buffer.data(values, GL_DYNAMIC_DRAW);
+
+  auto readback = buffer.read_async(16 * sizeof(GLint), 4 * sizeof(GLint));
+  expect("readback has its size", readback.size(), 4 * sizeof(GLint));
+  expect("readback completes", readback.wait());
+  expect("readback is ready", readback.ready());
+  auto result = readback.get<GLint>();
+  expect("readback result", result.size() == 4 && result[0] == 16 && result[3] == 19);
+
+  GLint destination[2] = { 0, 0 };
+  auto into = buffer.read_async(100 * sizeof(GLint), sizeof(destination), destination);
+  into.data();
+  expect("readback into caller memory", destination[0] == 100 && destination[1] == 101);
+
+  auto recycled = buffer.read_async(0, 4 * sizeof(GLint), std::move(readback));
+  expect("recycled readback is fresh", recycled.get<GLint>()[1], 1);
+  expect("moved-from readback is empty", readback.empty() && !readback.ready());
+
+  destination[0] = -1;
+  auto recycled_into = buffer.read_async(0, sizeof(GLint), std::move(into));
+  expect("recycling drops the old destination", recycled_into.get<GLint>()[0] == 0 && destination[0] == -1);
+  auto recycled_to = buffer.read_async(8 * sizeof(GLint), sizeof(GLint), std::move(recycled_into), destination);
+  recycled_to.data();
+  expect("recycling into a new destination", destination[0], 8);
+
+  gl::Readback pending;
+  expect("a new Readback has nothing to wait for", pending.empty() && !pending.ready() && !pending.wait(0));
+
+  EXPECT_THROW("reading past the end throws", buffer.read_async(0, 257 * sizeof(GLint)));
+}
+
+
+void test_buffer_heap(gl::Context& context) {
+  gl::BufferHeap heap (1 << 16, 256);
+
+  auto a = heap.allocate(100);
+  auto b = heap.allocate(300);
+  auto c = heap.allocate(100);
+  expect("slices share a buffer", a.buffer == b.buffer && b.buffer == c.buffer);
+  expect("slices don't overlap", a.offset + a.size <= c.offset && b.offset >= c.offset + c.size);
+  expect("one backing buffer", heap.stats().backing_buffers, size_t(1));
+  expect("blocks round up", heap.stats().allocated, size_t(256 + 512 + 256));
+  expect("requested bytes", heap.stats().requested, size_t(500));
+
+  heap.free(a);
+  auto d = heap.allocate(200);
+  expect("freed block is reused", d.offset, a.offset);
+
+  auto strided = heap.allocate(12 * 10, 12);
+  expect("offset is a multiple of the stride", strided.offset % 12, size_t(0));
+
+  heap.free(b);
+  heap.free(c);
+  heap.free(d);
+  heap.free(strided);
+  auto stats = heap.stats();
+  expect("everything merges back", stats.free_ranges == 1 && stats.largest_free == heap.buffer_size());
+  expect("no fragmentation when empty", stats.fragmentation() == 0.0);
+
+  std::vector<GLfloat> quad ({
+    -1.f, -1.f,
+    +1.f, -1.f,
+    -1.f, +1.f,
+    +1.f, +1.f,
+  });
+  auto first = heap.store(quad, 2 * sizeof(GLfloat));
+  auto second = heap.store(quad, 2 * sizeof(GLfloat));
+  GLfloat value;
+  first.buffer->get(second.offset + 2 * sizeof(GLfloat), sizeof(value), &value);
+  expect("stored data is uploaded", value, 1.f);
+  expect("big allocations get another buffer", heap.allocate(1 << 16).buffer != first.buffer);
+  EXPECT_THROW("too big for a backing buffer", heap.allocate((1 << 16) + 1));
+
+  gl::Program program (
+    gl::VertexShader("shaders/vert.glsl"),
+    gl::FragmentShader("shaders/frag.glsl")
+  );
+  gl::attrib position (program.attrib_location("position"));
+  gl::VertexArray vao (GL_TRIANGLE_STRIP);
+  vao.pointer(*first.buffer, position, 2, GL_FLOAT, false, 0, 0);
+  vao.enable(position);
+  bool threw = false;
+  try {
+    context.draw(program, vao, GL_TRIANGLE_STRIP, first, 2 * sizeof(GLfloat));
+    context.draw(program, vao, GL_TRIANGLE_STRIP, second, 2 * sizeof(GLfloat));
+  } catch (...) {
+    threw = true;
+  }
+  expect("meshes draw from one VertexArray by offset", !threw);
+}
+
+
+void test_buffer_copy(gl::Context& context) {
+  std::vector<GLint> values (1024);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = GLint(i);
+  }
+  gl::Buffer source;
+  source.data(values, GL_STATIC_DRAW);
+  gl::Buffer destination;
+  destination.data(GLsizei(values.size() * sizeof(GLint)), GL_STATIC_DRAW);
+
+  source.copy_to(destination, 10 * sizeof(GLint), 0, 4 * sizeof(GLint));
+  GLint value;
+  destination.get(3 * sizeof(GLint), sizeof(value), &value);
+  expect("copied region", value, 13);
+
+  source.copy_to(destination, std::vector<gl::BufferCopy>({
+    { 0, 100 * sizeof(GLint), sizeof(GLint) },
+    { 500 * sizeof(GLint), 101 * sizeof(GLint), sizeof(GLint) },
+  }));
+  GLint pair[2];
+  destination.get(100 * sizeof(GLint), sizeof(pair), pair);
+  expect("batched copies", pair[0] == 0 && pair[1] == 500);
+
+  source.copy_to(source, 0, 512 * sizeof(GLint), 4 * sizeof(GLint));
+  EXPECT_THROW("overlapping copy within a buffer throws", source.copy_to(source, 0, 2 * sizeof(GLint), 4 * sizeof(GLint)));
+  EXPECT_THROW("copy past the end throws", source.copy_to(destination, 1000 * sizeof(GLint), 0, 100 * sizeof(GLint)));
+
+  source.clear(4 * sizeof(GLint), 1000 * sizeof(GLint), 7);
+  std::vector<GLint> cleared (values.size());
+  source.get(0, cleared.size() * sizeof(GLint), cleared.data());
+  expect("clear fills the range", cleared[4] == 7 && cleared[1003] == 7);
+  expect("clear leaves the rest", cleared[3] == 3 && cleared[1004] == 1004);
+  source.clear();
+  source.get(1023 * sizeof(GLint), sizeof(value), &value);
+  expect("clear everything to zero", value, 0);
+  EXPECT_THROW("unaligned clear throws", source.clear(2, 8));
+}
+
+
+void test_move(gl::Context& context) {
+  std::vector<gl::Buffer> buffers;
+  for (int i = 0; i < 4; ++i) {
+    buffers.emplace_back(std::vector<GLint>({ i }), GL_STATIC_DRAW);
+  }
+  GLint value;
+  buffers[3].get(0, sizeof(value), &value);
+  expect("buffers survive reallocation in a vector", value, 3);
+  expect("buffers, programs and shaders move without throwing",
+    std::is_nothrow_move_constructible<gl::Buffer>::value
+    && std::is_nothrow_move_constructible<gl::Program>::value
+    && std::is_nothrow_move_constructible<gl::VertexShader>::value
+    && std::is_nothrow_move_assignable<gl::Buffer>::value
+    && std::is_nothrow_move_assignable<gl::Program>::value
+    && std::is_nothrow_move_assignable<gl::VertexShader>::value);
+
+  gl::Buffer moved (std::move(buffers[0]));
+  expect("moved-from buffer has no name", buffers[0].name(), 0u);
+  expect("moved-to buffer keeps its size", moved.size(), sizeof(GLint));
+
+  GLuint replaced = buffers[1].name();
+  buffers[1] = std::move(moved);
+  context.flush_deletions();
+  expect("move assignment deletes the old buffer", !glIsBuffer(replaced));
+  buffers[1].get(0, sizeof(value), &value);
+  expect("move assignment takes the contents", value, 0);
+
+  gl::Texture2D texture;
+  GLuint texture_name = texture.name();
+  gl::Texture2D other (std::move(texture));
+  expect("texture name moves", other.name(), texture_name);
+  expect("texture target moves", other.target(), GLenum(GL_TEXTURE_2D));
+
+  gl::Cubemap cubemap;
+  GLuint cubemap_name = cubemap.name();
+  gl::Cubemap cubemap2 (std::move(cubemap));
+  expect("cubemap faces alias the moved name", cubemap2[gl::Cubemap::NEGATIVE_Z].name(), cubemap_name);
+  expect("moved-from faces have no name", cubemap[gl::Cubemap::POSITIVE_X].name(), 0u);
+  cubemap2.storage(1, 4, 4);
+
+  gl::Program program;
+  GLuint program_name = program.name();
+  gl::Program program2 (std::move(program));
+  expect("program name moves", program2.name() == program_name && program.name() == 0);
+
+  std::vector<gl::VertexArray> vertex_arrays (2);
+  vertex_arrays.emplace_back(GL_TRIANGLES);
+  expect("vertex arrays in a vector", vertex_arrays[2].mode(), GLenum(GL_TRIANGLES));
+}
+
+
+void test_persistent_buffer(gl::Context& context) {
+  if (context.major_version() * 10 + context.minor_version() < 44) {
+    logw("skipping persistent buffer tests: they need OpenGL 4.4");
+    return;
+  }
+
+  gl::Buffer coherent;
+  coherent.storage(16 * sizeof(GLint), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+  auto values = coherent.persistent_map<GLint>();
+  expect("span covers the buffer", values.size(), size_t(16));
+  values[3] = 42;
+  gl::Sync().wait();
+  GLint value = 0;
+  coherent.get(3 * sizeof(GLint), sizeof(GLint), &value);
+  expect("coherent write is visible", value, 42);
+  expect("mapping again returns the same memory", coherent.persistent_map<GLint>().data() == values.data());
+  EXPECT_THROW("immutable storage can't be respecified", coherent.data(64, GL_DYNAMIC_DRAW));
+
+  gl::Buffer flushed;
+  flushed.storage(16 * sizeof(GLint), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+  auto more = flushed.persistent_map<GLint>();
+  more[8] = 7;
+  flushed.flush_range(more.subspan(8, 1));
+  gl::Sync().wait();
+  flushed.get(8 * sizeof(GLint), sizeof(GLint), &value);
+  expect("flushed write is visible", value, 7);
+
+  gl::Buffer plain;
+  plain.data(64, GL_DYNAMIC_DRAW);
+  EXPECT_THROW("mutable storage can't be persistently mapped", plain.persistent_map());
+}
+
+
+void test_name_pool(gl::Context& context) {
+  context.flush_deletions();
+  std::vector<GLuint> names;
+  {
+    std::vector<gl::Buffer> buffers;
+    for (GLint i = 0; i < 100; ++i) {
+      buffers.emplace_back(std::vector<GLint>({ i }), GL_STATIC_DRAW);
+      names.push_back(buffers.back().name());
+    }
+    std::sort(names.begin(), names.end());
+    expect("pooled names are distinct", std::unique(names.begin(), names.end()) == names.end());
+  }
+  expect("destroyed buffers are queued", context.pending_deletions(), size_t(100));
+
+  GLuint vao_name;
+  {
+    gl::VertexArray vao;
+    gl::VertexArrayBindguard guard (vao);
+    vao_name = vao.name();
+  }
+  expect("queued names still exist", glIsBuffer(names.front()) && glIsVertexArray(vao_name));
+
+  context.end_frame();
+  expect("end_frame flushes the queue", context.pending_deletions(), size_t(0));
+  bool deleted = true;
+  for (auto name : names) {
+    deleted = deleted && !glIsBuffer(name);
+  }
+  expect("flushed names are deleted", deleted && !glIsVertexArray(vao_name));
+
+  {
+    std::vector<gl::Texture2D> textures (2000);
+  }
+  expect("a long queue flushes itself", context.pending_deletions() < size_t(2000));
+
+  {
+    gl::Buffer buffer (std::vector<GLint>({ 1 }), GL_STATIC_DRAW);
+  }
+  context.clear(GL_COLOR_BUFFER_BIT);
+  expect("clearing the framebuffer flushes the queue", context.pending_deletions(), size_t(0));
+}
+
+void test_deferred_deletion(gl::Context& context) {
+  context.end_frame();
+  std::vector<GLuint> names;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    std::vector<gl::Buffer> buffers;
+    for (GLint i = 0; i < 50; ++i) {
+      buffers.emplace_back(std::vector<GLint>({ i }), GL_STATIC_DRAW);
+      names.push_back(buffers.back().name());
+    }
+    threads.emplace_back([](std::vector<gl::Buffer> buffers) { buffers.clear(); }, std::move(buffers));
+  }
+  gl::Program program;
+  GLuint program_name = program.name();
+  threads.emplace_back([](gl::Program program) {}, std::move(program));
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  expect("objects destroyed on other threads aren't deleted there", glIsBuffer(names.back()) && glIsProgram(program_name));
+  expect("nor counted as pending here", context.pending_deletions(), size_t(0));
+
+  context.end_frame();
+  bool deleted = true;
+  for (auto name : names) {
+    deleted = deleted && !glIsBuffer(name);
+  }
+  expect("end_frame deletes what other threads destroyed", deleted && !glIsProgram(program_name));
+}
+
+void test_block_layout(gl::Context& context) {
+  using vec2 = gl::glsl::vec<float, 2>;
+  using vec3 = gl::glsl::vec<float, 3>;
+  using vec4 = gl::glsl::vec<float, 4>;
+  using mat3 = gl::glsl::mat<float, 3>;
+  using Std140 = gl::BlockLayout<gl::LAYOUT_STD140, float, vec2, vec3, float, gl::glsl::array<float, 2>, mat3, vec4>;
+  using Std430 = gl::BlockLayout<gl::LAYOUT_STD430, float, vec2, vec3, float, gl::glsl::array<float, 2>, mat3, vec4>;
+
+  std::vector<size_t> std140, std430;
+  for (size_t i = 0; i < Std140::count; ++i) {
+    std140.push_back(Std140::offset(i));
+    std430.push_back(Std430::offset(i));
+  }
+  expect("std140 offsets", std140 == std::vector<size_t>({ 0, 8, 16, 28, 32, 64, 112 }));
+  expect("std140 size", Std140::size(), size_t(128));
+  expect("std430 offsets", std430 == std::vector<size_t>({ 0, 8, 16, 28, 32, 48, 96 }));
+  expect("std430 size", Std430::size(), size_t(112));
+  static_assert(Std140::offset<6>() == 112, "layouts are computed at compile time");
+
+  gl::VertexShader shader;
+  shader.set_source(
+    "#version 410\n"
+    "layout(std140) uniform Block { float a; vec2 b; vec3 c; float d; float e[2]; mat3 f; vec4 g; };\n"
+    "void main() { gl_Position = vec4(f * c, a + d + e[1]) + g + b.xyxy; }\n"
+  );
+  shader.compile();
+  gl::Program program (shader);
+  const char* names[] = { "a", "b", "c", "d", "e[0]", "f", "g" };
+  GLuint indices[7];
+  GLint offsets[7];
+  glGetUniformIndices(program.name(), 7, names, indices);
+  glGetActiveUniformsiv(program.name(), 7, indices, GL_UNIFORM_OFFSET, offsets);
+  std::vector<size_t> driver (offsets, offsets + 7);
+  expect("std140 offsets match the driver's", driver == std140);
+
+  gl::TypedUniformBuffer<Std140> block;
+  expect("a new block is clean", !block.dirty());
+  block.set<0>(1.f);
+  block.set<2>(glm::vec3(1, 2, 3));
+  expect("members written in order share a range", block.dirty_ranges().size(), size_t(1));
+  block.set<6>(glm::vec4(4));
+  expect("distant members get their own ranges", block.dirty_ranges().size(), size_t(2));
+  expect("flush uploads only the dirty ranges", block.flush(), size_t(28 + 16));
+  expect("flushing cleans", !block.dirty() && block.flush() == 0);
+
+  block.set<4>(5.f, 1);
+  block.set<5>(glm::mat3(2));
+  block.bind(0);
+  GLfloat column[4];
+  block.buffer().get(Std140::offset<5>() + 16, sizeof(column), column);
+  expect("matrix columns are padded to vec4", column[0] == 0.f && column[1] == 2.f && column[2] == 0.f);
+  GLfloat element;
+  block.buffer().get(Std140::offset<4>() + 16, sizeof(element), &element);
+  expect("array elements are uploaded at their stride", element, 5.f);
+  EXPECT_THROW("writing past an array throws", block.set<4>(1.f, 2));
+}
+
+void test_uniform_blocks(gl::Context& context) {
+  auto vertex_shader = [](std::string const& body) {
+    gl::VertexShader shader;
+    shader.set_source("#version 420\n" + body);
+    shader.compile();
+    return shader;
+  };
+  gl::Program first (vertex_shader(
+    "layout(std140) uniform Camera { mat4 view; vec4 position; float lights[3]; };\n"
+    "layout(std140) uniform Material { vec4 color; };\n"
+    "void main() { gl_Position = view * position * lights[2] + color; }\n"
+  ));
+  gl::Program second (vertex_shader(
+    "layout(std140, binding = 7) uniform Pinned { vec4 offset; };\n"
+    "layout(std140) uniform Camera { mat4 view; vec4 position; float lights[3]; };\n"
+    "void main() { gl_Position = view * position * lights[0] + offset; }\n"
+  ));
+
+  expect("active blocks are reflected", first.uniform_blocks().size(), size_t(2));
+  auto camera = first.uniform_block("Camera");
+  expect("blocks are found by name", camera != nullptr && first.uniform_block("Nothing") == nullptr);
+  expect("block members are reflected in order", camera->members.size() == 3 && camera->members[1].name == "position");
+  expect("member offsets and strides", camera->members[1].offset == 64 && camera->members[2].array_stride == 16 && camera->members[0].matrix_stride == 16);
+  expect("block size", camera->size, 128);
+
+  GLuint binding = context.uniform_block_binding("Camera");
+  expect("blocks are bound at link", camera->binding, binding);
+  expect("a block gets the same binding in every program", second.uniform_block("Camera")->binding, binding);
+  expect("different blocks get different bindings", first.uniform_block("Material")->binding != binding);
+  expect("explicit bindings are kept", second.uniform_block("Pinned")->binding, 7u);
+  GLint bound;
+  glGetActiveUniformBlockiv(second.name(), second.uniform_block("Camera")->index, GL_UNIFORM_BLOCK_BINDING, &bound);
+  expect("the driver has the binding", GLuint(bound), binding);
+
+  using Camera = gl::BlockLayout<gl::LAYOUT_STD140, gl::glsl::mat<float, 4>, gl::glsl::vec<float, 4>, gl::glsl::array<float, 3>>;
+  using Wrong = gl::BlockLayout<gl::LAYOUT_STD140, gl::glsl::mat<float, 4>, gl::glsl::vec<float, 4>, gl::glsl::vec<float, 3>>;
+  bool threw = false;
+  try {
+    first.verify_uniform_block<Camera>("Camera");
+    first.verify_uniform_block("Material", { 0 });
+  } catch (gl::exception const&) {
+    threw = true;
+  }
+  expect("matching layouts verify", !threw);
+  EXPECT_THROW("a layout that doesn't match throws", first.verify_uniform_block<Wrong>("Camera"));
+  EXPECT_THROW("offsets that don't match throw", first.verify_uniform_block("Camera", { 0, 16, 80 }));
+
+  auto intruder = vertex_shader(
+    "layout(std140, binding = " + std::to_string(binding) + ") uniform Intruder { vec4 offset; };\n"
+    "void main() { gl_Position = offset; }\n"
+  );
+  EXPECT_THROW("an explicit binding can't take a point given to another block", gl::Program program (intruder));
+}
+
+void test_storage_buffers(gl::Context& context) {
+#ifdef GL_VERSION_4_3
+  if (!context.capabilities().version_at_least(4, 3)) {
+    return;
+  }
+  gl::ComputeShader shader;
+  shader.set_source(
+    "#version 430\n"
+    "layout(local_size_x = 64) in;\n"
+    "layout(std430) readonly buffer Transforms { mat4 model[]; };\n"
+    "layout(std430) writeonly buffer Positions { vec4 positions[]; };\n"
+    "layout(binding = 0, offset = 4) uniform atomic_uint count;\n"
+    "void main() {\n"
+    "  uint i = gl_GlobalInvocationID.x;\n"
+    "  positions[i] = model[i] * vec4(1);\n"
+    "  atomicCounterIncrement(count);\n"
+    "}\n"
+  );
+  shader.compile();
+  gl::Program program (shader);
+
+  expect("storage blocks are reflected", program.storage_blocks().size(), size_t(2));
+  auto transforms = program.storage_block("Transforms");
+  expect("unsized arrays have size 0", transforms && transforms->members.size() == 1 && transforms->members[0].size == 0);
+  expect("storage member strides", transforms->members[0].array_stride == 64 && transforms->members[0].matrix_stride == 16);
+  expect("storage blocks get bindings by name", transforms->binding, context.storage_block_binding("Transforms"));
+  expect("different storage blocks get different bindings", program.storage_block("Positions")->binding != transforms->binding);
+
+  using Positions = gl::BlockLayout<gl::LAYOUT_STD430, gl::glsl::array<gl::glsl::vec<float, 4>, 1>>;
+  bool threw = false;
+  try {
+    program.verify_storage_block<Positions>("Positions");
+  } catch (gl::exception const&) {
+    threw = true;
+  }
+  expect("storage blocks verify against a std430 layout", !threw);
+
+  const size_t count = 1024;
+  std::vector<GLfloat> models (count * 16, 0.f);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t d = 0; d < 4; ++d) {
+      models[i * 16 + d * 5] = GLfloat(i);
+    }
+  }
+  gl::ShaderStorageBuffer model_buffer, position_buffer;
+  model_buffer.data(models, GL_STATIC_DRAW);
+  position_buffer.data(GLsizei(count * 4 * sizeof(GLfloat)), GL_DYNAMIC_READ);
+  gl::AtomicCounterBuffer counters (2);
+  expect("counters start at 0", counters.values() == std::vector<GLuint>({ 0, 0 }));
+  counters.set(1, 5);
+
+  model_buffer.bind(context.storage_block_binding("Transforms"));
+  position_buffer.bind(context.storage_block_binding("Positions"), 0, count * 4 * sizeof(GLfloat));
+  counters.bind(0);
+  {
+    gl::ProgramBindguard guard (program);
+    glDispatchCompute(count / 64, 1, 1);
+  }
+  context.memory_barrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+  GLfloat position[4];
+  position_buffer.buffer().get(700 * sizeof(position), sizeof(position), position);
+  expect("compute shader writes the storage buffer", position[0] == 700.f && position[3] == 700.f);
+  expect("atomic counters count", counters.get(1), GLuint(5 + count));
+  counters.reset();
+  expect("reset clears the counters", counters.get(1), 0u);
+
+  size_t alignment = context.capabilities().shader_storage_buffer_offset_alignment;
+  if (alignment > 1) {
+    EXPECT_THROW("misaligned ranges throw", position_buffer.bind(0, alignment / 2, 16));
+  }
+  EXPECT_THROW("ranges past the end throw", position_buffer.bind(0, 0, count * 32));
+#endif
+}
+
+void test_uniform_cache(gl::Context& context) {
+  gl::VertexShader shader;
+  shader.set_source(
+    "#version 410\n"
+    "uniform mat4 view;\n"
+    "uniform vec4 tint;\n"
+    "uniform float weights[3];\n"
+    "void main() { gl_Position = view * tint * (weights[0] + weights[1] + weights[2]); }\n"
+  );
+  shader.compile();
+  gl::Program program (shader);
+
+  gl::uniform_mat4 view (program.uniform("view"));
+  gl::uniform4<float> tint (program.uniform("tint"));
+  const GLfloat identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+  view.set(identity);
+  view.set(identity);
+  tint.set(0.5f, 0.25f, 1.f, 1.f);
+  tint.set(gl::vec4<float>(0.5f, 0.25f, 1.f, 1.f));
+  expect("identical sets are skipped", program.uniform_stats().skipped, uint64_t(2));
+  expect("first sets are issued", program.uniform_stats().issued, uint64_t(2));
+
+  tint.set(0.5f, 0.25f, 1.f, 0.f);
+  expect("a changed value is issued", program.uniform_stats().issued, uint64_t(3));
+  expect("the driver has the value", tint.get().w, 0.f);
+
+  view.set(identity, true);
+  view.set(identity);
+  expect("transposed sets aren't followed", program.uniform_stats().issued, uint64_t(5));
+
+  const GLfloat weights[3] = { 1.f, 2.f, 3.f };
+  GLint location = program.uniform_location("weights");
+  program.reset_uniform_stats();
+  GL_CALL(glProgramUniform1fv(program.name(), location, 3, weights));
+  program.invalidate_uniforms();
+  gl::uniform<float> first (program.uniform(location));
+  first.set(1.f);
+  first.set(1.f);
+  expect("invalidated values are issued again", program.uniform_stats().issued == 1 && program.uniform_stats().skipped == 1);
+
+  gl::uniform<float> missing (program.uniform("missing"));
+  missing.set(1.f);
+  expect("inactive uniforms aren't counted", program.uniform_stats().issued, uint64_t(1));
+
+  gl::CommandBuffer commands;
+  commands.uniform(program, tint.location(), 0.f, 0.f, 0.f, 1.f);
+  context.execute(commands);
+  tint.set(0.5f, 0.25f, 1.f, 0.f);
+  expect("replayed uniforms go through the cache", tint.get().x, 0.5f);
+
+  std::vector<gl::Program> programs;
+  programs.emplace_back(shader);
+  GLint tint_location = programs[0].uniform_location("tint");
+  commands.reset();
+  commands.uniform(programs[0], tint_location, 0.f, 1.f, 0.f, 1.f);
+  commands.uniform(programs[0], tint_location, 0.f, 1.f, 0.f, 1.f);
+  while (programs.size() < 8) {
+    programs.emplace_back(shader);
+  }
+  context.execute(commands);
+  GLfloat replayed[4];
+  glGetUniformfv(programs[0].name(), tint_location, replayed);
+  auto const& stats = programs[0].uniform_stats();
+  expect("a Program moved after recording gets the uniform", replayed[1] == 1.f && stats.issued == 1 && stats.skipped == 1);
+}
+
+void test_uniform_names(gl::Context&) {
+  gl::VertexShader shader;
+  shader.set_source(
+    "#version 410\n"
+    "in vec3 position;\n"
+    "in float weight;\n"
+    "uniform mat4 view;\n"
+    "uniform vec4 tint;\n"
+    "uniform float weights[8];\n"
+    "uniform bool enabled;\n"
+    "uniform sampler2D image;\n"
+    "void main() {\n"
+    "  float sum = 0.0;\n"
+    "  for (int i = 0; i < 8; ++i) { sum += weights[i]; }\n"
+    "  vec4 texel = textureLod(image, position.xy, 0.0);\n"
+    "  gl_Position = enabled ? view * tint * texel * sum * weight : vec4(position, 1.0);\n"
+    "}\n"
+  );
+  shader.compile();
+  gl::Program program (shader);
+
+  bool same = true;
+  for (auto name : { "view", "tint", "weights", "weights[0]", "weights[5]", "weights[7]", "enabled", "image" }) {
+    same = same && program.uniform_location(name) == glGetUniformLocation(program.name(), name);
+  }
+  expect("uniform locations match the driver's", same);
+  expect("inactive uniforms have no location", program.uniform_location("missing"), -1);
+  expect("attribute locations match the driver's", program.attrib_location("weight"), glGetAttribLocation(program.name(), "weight"));
+  expect("inactive attributes have no location", program.attrib_location("missing"), -1);
+
+  auto weights = program.uniform_variable("weights");
+  expect("uniform types and sizes are reflected", weights && weights->type == GL_FLOAT && weights->size == 8);
+  expect("array elements count to the end", program.uniform_variable("weights[5]")->size, 3);
+  expect("attribute types are reflected", program.attrib_variable("position")->type, GLenum(GL_FLOAT_VEC3));
+  expect("missing names aren't reflected", program.uniform_variable("missing") == nullptr);
+
+  bool threw = false;
+  try {
+    gl::uniform4<float> tint (program.uniform("tint"));
+    gl::uniform_mat4 view (program.uniform("view"));
+    gl::uniform<float> weight (program.uniform("weights[2]"));
+    gl::uniform<GLint> enabled (program.uniform("enabled"));
+    gl::uniform_sampler image (program.uniform("image"));
+    gl::uniform3<float> missing (program.uniform("missing"));
+  } catch (gl::exception const&) {
+    threw = true;
+  }
+  expect("matching types are accepted", !threw);
+  EXPECT_THROW("a vec4 isn't a vec3", gl::uniform3<float>(program.uniform("tint")));
+  EXPECT_THROW("a float isn't an int", gl::uniform<GLint>(program.uniform("weights")));
+  EXPECT_THROW("a mat4 isn't a mat3", gl::uniform_mat3(program.uniform("view")));
+  EXPECT_THROW("untyped sets are checked", (program["tint"].set(1.f, 2.f)));
+}
+
+void test_stream_buffer(gl::Context& context) {
+  size_t alignment = context.capabilities().uniform_buffer_offset_alignment;
+  gl::StreamBuffer stream (context, 8 * alignment, 2);
+  expect("alignment follows the context", stream.alignment(), alignment);
+
+  auto a = stream.write(std::vector<GLint>({ 1, 2, 3 }));
+  auto b = stream.allocate<GLfloat>(4);
+  b.data[0] = 0.5f;
+  expect("allocations are aligned", b.offset % alignment, size_t(0));
+  expect("allocations don't overlap", b.offset >= a.offset + a.size);
+  stream.flush();
+
+  GLint value = 0;
+  stream.buffer().get(a.offset + 2 * sizeof(GLint), sizeof(GLint), &value);
+  expect("written data reaches the buffer", value, 3);
+
+  stream.bind(GL_UNIFORM_BUFFER, 0, b);
+  expect("bound as a uniform range", context.get<unsigned, GL_UNIFORM_BUFFER_BINDING>(), stream.buffer().name());
+
+  for (int frame = 0; frame < 8; ++frame) {
+    stream.allocate<char>(3 * alignment);
+    stream.end_frame();
+    expect("frames in flight are bounded", stream.frames_in_flight() <= 2);
+  }
+
+  auto wrapped = stream.allocate<char>(7 * alignment);
+  expect("allocation wraps around", wrapped.offset, size_t(0));
+  EXPECT_THROW("allocation bigger than the ring throws", stream.allocate<char>(9 * alignment));
+  stream.end_frame();
+}
+
+
+void test_upload_queue(gl::Context& context, gl::UploadQueue::ContextFactory factory) {
+  gl::UploadQueue uploads (factory);
+
+  std::vector<GLint> values (1 << 20);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = GLint(i);
+  }
+
+  gl::Buffer buffer;
+  bool ready = false;
+  uploads.submit([&]() { buffer.data(values, GL_STATIC_DRAW); }, [&]() { ready = true; });
+  expect("upload pending", uploads.pending(), size_t(1));
+  expect("finish hands back the upload", uploads.finish(), size_t(1));
+  expect("ready callback ran", ready);
+  expect("nothing left pending", uploads.pending(), size_t(0));
+
+  GLint last;
+  buffer.get((values.size() - 1) * sizeof(GLint), sizeof(GLint), &last);
+  expect("uploaded contents are visible", last, values.back());
+
+  bool polled = false;
+  uploads.submit([&]() { buffer.data(values, GL_STATIC_DRAW); }, [&]() { polled = true; });
+  size_t handed_back = 0;
+  for (int i = 0; i < 1000 && !handed_back; ++i) {
+    handed_back = uploads.poll();
+    if (!handed_back) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  expect("poll hands back the upload once its fence signals", handed_back == 1 && polled);
+
+  uploads.submit([]() { throw gl::exception("upload failed"); });
+  EXPECT_THROW("a failed upload rethrows from poll", uploads.finish());
+}
+
+
+void test_headless_context(gl::Context&) {
+#ifdef UGLY_HEADLESS
+  // A HeadlessContext is a MultiContext: give it a thread of its own so the
+  // window's context stays current here.
+  auto clear_and_read = [](glx::HeadlessContext& context, GLfloat green) {
+    context.make_current();
+    context.clear_color(0.f, green, 0.f);
+    context.clear(GL_COLOR_BUFFER_BIT);
+    uint8_t pixel[4] = { 0, 0, 0, 0 };
+    glReadPixels(GLint(context.width() / 2), GLint(context.height() / 2), 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    return GLuint(pixel[1]);
+  };
+
+  bool current = false;
+  GLuint first = 0, second = 0, after = 0;
+  std::thread worker ([&]() {
+    try {
+      glx::HeadlessConfig config;
+      config.width = config.height = 16;
+      {
+        glx::HeadlessContext context (config);
+        current = context.current();
+        first = clear_and_read(context, 1.f);
+        glx::HeadlessContext other (config);
+        second = clear_and_read(other, 0.5f);
+      }
+      // The display was terminated with the last context; it comes back.
+      glx::HeadlessContext again (config);
+      after = clear_and_read(again, 1.f);
+    } catch (gl::exception const& e) {
+      loge("headless context: %s", e.what());
+    }
+  });
+  worker.join();
+
+  expect("a new HeadlessContext is current", current);
+  expect("clear and read back", first, 255u);
+  expect("a second HeadlessContext on the same display", second == 127u || second == 128u);
+  expect("a HeadlessContext after the display was terminated", after, 255u);
+#endif
+}
+
+
+void test_orphaned_names(gl::Context&) {
+#ifdef UGLY_HEADLESS
+  bool buffer_deleted = false, vertex_array_kept = false, reused = false;
+  std::thread worker ([&]() {
+    try {
+      glx::HeadlessConfig config;
+      config.width = config.height = 16;
+      glx::HeadlessContext survivor (config);
+      std::unique_ptr<glx::HeadlessContext> owner (new glx::HeadlessContext(config, &survivor));
+      std::unique_ptr<gl::Buffer> buffer (new gl::Buffer());
+      buffer->data(std::vector<GLint>({ 1 }), GL_STATIC_DRAW);
+      std::unique_ptr<gl::VertexArray> vao (new gl::VertexArray());
+      GLuint buffer_name = buffer->name(), vao_name = vao->name();
+
+      // The owner is destroyed while another Context is current.
+      survivor.make_current();
+      owner.reset();
+
+      // A vertex array of the survivor's own under the same name, within the
+      // first block of names it generates.
+      std::vector<gl::VertexArray> vaos (64);
+      for (auto const& v : vaos) {
+        reused = reused || v.name() == vao_name;
+      }
+      glBindVertexArray(vao_name);
+      glBindVertexArray(0);
+      survivor.invalidate_state();
+
+      buffer.reset();
+      vao.reset();
+      survivor.flush_deletions();
+      buffer_deleted = !glIsBuffer(buffer_name);
+      vertex_array_kept = glIsVertexArray(vao_name);
+    } catch (gl::exception const& e) {
+      loge("orphaned names: %s", e.what());
+    }
+  });
+  worker.join();
+
+  expect("a shared name outliving its Context is deleted by another", buffer_deleted);
+  expect("the survivor made a vertex array with the orphan's name", reused);
+  expect("an orphaned vertex array name isn't deleted from another Context", vertex_array_kept);
+#endif
+}
+
+void test_capabilities(gl::Context const& context) {
+  auto const& caps = context.capabilities();
+  expect("snapshot matches GL_MAX_TEXTURE_IMAGE_UNITS",
+    caps.max_texture_image_units, context.get<unsigned, GL_MAX_TEXTURE_IMAGE_UNITS>());
+  expect("snapshot matches GL_MAX_UNIFORM_BLOCK_SIZE",
+    caps.max_uniform_block_size, context.get<unsigned, GL_MAX_UNIFORM_BLOCK_SIZE>());
+  expect("snapshot version matches", caps.major_version, context.major_version());
+  expect("extensions are listed", caps.extensions.size() == context.get<unsigned, GL_NUM_EXTENSIONS>());
+  expect("unknown extension is absent", !caps.has_extension("GL_UGLY_not_an_extension"));
+}
+
 
 
 int main(int argc, const char* const argv[]) {
@@ -411,7 +1432,7 @@ int main(int argc, const char* const argv[]) {
   }
 
   {
-    gl::uniform<int> a (program2, program2.uniform_location("color"));
+    gl::uniform4<float> a (program2, program2.uniform_location("color"));
     expect("existent uniform found", a.location() != -1);
   }
 
@@ -435,6 +1456,36 @@ int main(int argc, const char* const argv[]) {
   test_range_gets(context1);
   test_int_gets(context1);
   test_enum_gets(context1);
+  test_binding_policy(context1);
+  test_capabilities(context1);
+  test_render_state(context1);
+  test_error_policy(context1);
+  test_command_buffer(context1);
+  test_sync(context1);
+  test_map_range(context1);
+  test_read_async(context1);
+  test_buffer_heap(context1);
+  test_buffer_copy(context1);
+  test_move(context1);
+  test_persistent_buffer(context1);
+  test_stream_buffer(context1);
+  test_name_pool(context1);
+  test_deferred_deletion(context1);
+  test_block_layout(context1);
+  test_uniform_blocks(context1);
+  test_storage_buffers(context1);
+  test_uniform_cache(context1);
+  test_uniform_names(context1);
+  test_headless_context(context1);
+  test_orphaned_names(context1);
+
+  {
+    glfwApp worker_window (app);
+    test_upload_queue(context1, [&]() {
+      gl::OS_Bridge bridge { [](void* window) { static_cast<glfwApp*>(window)->make_current(); } };
+      return std::unique_ptr<gl::Context>(new gl::MultiContext(&worker_window, bridge));
+    });
+  }
 
 
 
@@ -536,6 +1587,7 @@ int main(int argc, const char* const argv[]) {
 
     GL_CALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
 
+    context1.end_frame();
     app.update();
     context1.clear();
   }